@@ -0,0 +1,134 @@
+#include "Runtime.hpp"
+#include "Cores.hpp"
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+
+struct NativeEntry
+{
+    char const* name;
+    u64 offset;
+    u8 const* image;
+    u64 size;
+    NativeProgram program;
+};
+
+static std::vector<NativeEntry>& Registry()
+{
+    static std::vector<NativeEntry> registry;
+    return registry;
+}
+
+NativeRegistration::NativeRegistration(char const* name, u64 offset, u8 const* image, u64 size, NativeProgram program)
+{
+    Registry().push_back({name, offset, image, size, program});
+}
+
+class PeripheralConsole
+{
+    Machine& machine;
+    std::thread runner;
+    std::atomic<bool> run = false;
+public:
+    PeripheralConsole(Machine& machine) :
+        machine(machine)
+    {
+        machine.Store(IO_PRINTC_ENABLE, 0);
+    }
+
+    void Start()
+    {
+        run = true;
+        runner = std::thread([this]() {
+            while(run)
+            {
+                if(machine.Load(IO_PRINTC_ENABLE) == 1)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    std::cout << machine.Load(IO_PRINTC_DATA);
+                    machine.Store(IO_PRINTC_ENABLE, 0);
+                }
+            }
+        });
+    }
+
+    void Stop()
+    {
+        run = false;
+        runner.join();
+    }
+};
+
+static NativeEntry const* FindProgram(u64 pc)
+{
+    for (auto const& entry : Registry())
+    {
+        if (pc >= entry.offset && pc < entry.offset + entry.size)
+            return &entry;
+    }
+    return nullptr;
+}
+
+// runs one core until it halts, or until stopping is set because core 0 halted.
+// returns false if control reached code without a native program.
+static bool RunCore(u8* memory, u64 core, u64 pc, std::atomic<bool> const& stopping)
+{
+    Machine machine(memory, core, stopping);
+    while(pc != native_halt)
+    {
+        if (stopping.load(std::memory_order_relaxed))
+            return true;
+
+        NativeEntry const* entry = FindProgram(pc);
+        if (entry == nullptr)
+        {
+            std::cout << "NO NATIVE PROGRAM AT " << pc << std::endl;
+            return false;
+        }
+
+        u64 next = entry->program(machine, pc);
+        if (next != native_halt && next >= entry->offset && next < entry->offset + entry->size)
+        {
+            // programs only hand back pcs they have no entry for
+            std::cout << "NO NATIVE ENTRY AT " << next << " IN " << entry->name << std::endl;
+            return false;
+        }
+        pc = next;
+    }
+
+    // core 0 halting stops the machine. other cores only stop themselves.
+    if (core == 0)
+    {
+        std::cout << "halt" << std::endl;
+        std::cout << "sp: " << machine.sp << std::endl;
+    }
+    return true;
+}
+
+int main()
+{
+    std::vector<u8> memory(memory_size);
+
+    // the images stay in guest memory so programs can still read their own bytes
+    for (auto const& entry : Registry())
+        std::copy(entry.image, entry.image + entry.size, memory.begin() + entry.offset);
+
+    Machine console(memory.data(), 0);
+    PeripheralConsole perConsole(console);
+    perConsole.Start();
+
+    PeripheralCores perCores(memory.data(), [&](u64 core, u64 pc, std::atomic<bool> const& stopping) {
+        return RunCore(memory.data(), core, pc, stopping);
+    });
+    perCores.Start();
+
+    // once core 0 halts the other cores are stopped
+    bool ok = RunCore(memory.data(), 0, offset_program, perCores.Stopping());
+    ok = perCores.Stop() && ok;
+    perConsole.Stop();
+
+    return ok ? 0 : 1;
+}
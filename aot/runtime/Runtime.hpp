@@ -0,0 +1,59 @@
+#pragma once
+
+#include "DataWriter.hpp"
+#include "Layout.hpp"
+
+#include <atomic>
+
+// returned by a native program when the guest executed halt, or when the core was stopped
+static constexpr u64 native_halt = ~(u64)0;
+
+// for machines no one stops
+inline std::atomic<bool> const never_stopping = false;
+
+struct Machine
+{
+    u8* memory;
+    DataWriter stack;
+    u64 sp = 0;
+    std::atomic<bool> const& stopping;
+
+    // one per core. cores share memory, each has its own stack.
+    Machine(u8* memory, u64 core, std::atomic<bool> const& stopping = never_stopping) :
+        memory(memory),
+        stack(memory + offset_stacks + core*stack_size),
+        stopping(stopping)
+    {}
+
+    // set once core 0 halted. programs check it on backward jumps so a spinning core returns.
+    bool Stopping() const
+    {
+        return stopping.load(std::memory_order_relaxed);
+    }
+
+    // global memory is shared with the peripherals, so it must not be cached in registers
+    u8 Load(u64 addr)
+    {
+        return ((u8 volatile*)memory)[addr];
+    }
+
+    void Store(u64 addr, u8 value)
+    {
+        ((u8 volatile*)memory)[addr] = value;
+    }
+
+    std::atomic_ref<u8> Atomic(u64 addr)
+    {
+        return std::atomic_ref<u8>(memory[addr]);
+    }
+};
+
+// runs the program from pc until control leaves it.
+// returns the pc to continue at, or native_halt.
+using NativeProgram = u64(*)(Machine& m, u64 pc);
+
+// generated translation units register themselves through a static instance of this
+struct NativeRegistration
+{
+    NativeRegistration(char const* name, u64 offset, u8 const* image, u64 size, NativeProgram program);
+};
\ No newline at end of file
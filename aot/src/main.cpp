@@ -0,0 +1,254 @@
+#include "Types.hpp"
+#include "Isa.hpp"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+
+struct Instruction
+{
+    u64 addr;
+    Opcode opcode;
+    u64 arg;
+    u64 size;
+};
+
+u64 ArgHex(std::string const& hex)
+{
+    return std::stoul(hex, nullptr, 16);
+}
+
+u64 ReadLE(std::vector<u8> const& bin, u64 pos, u8 size)
+{
+    u64 value = 0;
+    for (u8 i = 0; i < size; ++i)
+        value |= (u64)bin[pos+i] << (i*8);
+    return value;
+}
+
+// linear sweep. the assembler emits no data between instructions.
+std::vector<Instruction> Decode(std::vector<u8> const& bin, u64 offset)
+{
+    std::vector<Instruction> program;
+    u64 pos = 0;
+    while (pos < bin.size())
+    {
+        if (pos + opcode_size > bin.size())
+        {
+            std::string msg = "Truncated opcode at " + std::to_string(offset+pos);
+            std::cout << msg << std::endl;
+            throw std::runtime_error(msg);
+        }
+        u16 opcode = (u16)ReadLE(bin, pos, opcode_size);
+        if (opcode_length[opcode] == 0)
+        {
+            std::string msg = "Unknown opcode " + std::to_string(opcode) + " at " + std::to_string(offset+pos);
+            std::cout << msg << std::endl;
+            throw std::runtime_error(msg);
+        }
+        u8 argSize = isa[opcode].OperandSize();
+        if (pos + opcode_size + argSize > bin.size())
+        {
+            std::string msg = "Truncated operand at " + std::to_string(offset+pos);
+            std::cout << msg << std::endl;
+            throw std::runtime_error(msg);
+        }
+        program.push_back({offset+pos, (Opcode)opcode, ReadLE(bin, pos+opcode_size, argSize), (u64)(opcode_size+argSize)});
+        pos += opcode_size+argSize;
+    }
+    return program;
+}
+
+std::string Hex(u64 value)
+{
+    std::stringstream ss;
+    ss << "0x" << std::hex << value;
+    return ss.str();
+}
+
+std::string Label(u64 addr)
+{
+    std::stringstream ss;
+    ss << "L_" << std::hex << addr;
+    return ss.str();
+}
+
+std::string Translate(std::vector<u8> const& bin, u64 offset, std::string const& name)
+{
+    std::vector<Instruction> program = Decode(bin, offset);
+
+    std::set<u64> starts;
+    for (auto const& ins : program)
+        starts.insert(ins.addr);
+    auto isLocal = [&starts](u64 addr) { return starts.count(addr) != 0; };
+
+    // entries reachable from outside the function: the program start and every
+    // label operand that lands on an instruction. pushed ones are how return sites
+    // are made. jmps dispatches over the same set.
+    std::set<u64> entries;
+    if (!program.empty())
+        entries.insert(offset);
+    for (auto const& ins : program)
+    {
+        if (isa[(u64)ins.opcode].operand == Operand::label && isLocal(ins.arg))
+            entries.insert(ins.arg);
+    }
+
+    std::stringstream out;
+    // backward jumps check for a stop so loops end once core 0 halted. forward ones cannot loop.
+    static std::string const stopCheck = "if (m.Stopping()) { m.sp = sp; return native_halt; }";
+    auto jumpTo = [&](u64 addr, u64 from) {
+        if (isLocal(addr) && addr <= from)
+            return "{ " + stopCheck + " goto " + Label(addr) + "; }";
+        if (isLocal(addr))
+            return "goto " + Label(addr) + ";";
+        return "{ m.sp = sp; return " + Hex(addr) + "; }";
+    };
+
+    out << "// generated by aot. do not edit.\n";
+    out << "#include \"Runtime.hpp\"\n\n";
+
+    out << "static u8 const image_" << name << "[] = {";
+    for (u64 i = 0; i < bin.size(); ++i)
+        out << (i % 16 == 0 ? "\n    " : " ") << (u32)bin[i] << ",";
+    out << "\n};\n\n";
+
+    out << "static u64 Native_" << name << "(Machine& m, u64 pc)\n";
+    out << "{\n";
+    out << "    DataWriter stack = m.stack;\n";
+    out << "    u64 sp = m.sp;\n";
+    bool hasIndirect = std::any_of(program.begin(), program.end(), [](Instruction const& ins) { return ins.opcode == Opcode::jmps; });
+    if (hasIndirect)
+        out << "dispatch:\n";
+    out << "    switch(pc)\n";
+    out << "    {\n";
+    for (u64 entry : entries)
+        out << "        case " << Hex(entry) << ": goto " << Label(entry) << ";\n";
+    out << "        default: m.sp = sp; return pc;\n";
+    out << "    }\n";
+
+    for (auto const& ins : program)
+    {
+        if (entries.count(ins.addr) != 0)
+            out << Label(ins.addr) << ":\n";
+
+        switch(ins.opcode)
+        {
+            case Opcode::jmp:
+                out << "    " << jumpTo(ins.arg, ins.addr) << "\n";
+            break;
+            case Opcode::jmps:
+                out << "    sp -= 8;\n";
+                out << "    pc = stack.GetU64(sp);\n";
+                out << "    " << stopCheck << "\n";
+                out << "    goto dispatch;\n";
+            break;
+            case Opcode::jmp_true:
+                out << "    sp -= 1;\n";
+                out << "    if ((bool)stack.GetU8(sp)) " << jumpTo(ins.arg, ins.addr) << "\n";
+            break;
+            case Opcode::push_u8:
+                out << "    stack.Set(sp, (u8)" << ins.arg << ");\n";
+                out << "    sp += 1;\n";
+            break;
+            case Opcode::push_u64:
+                out << "    stack.Set(sp, (u64)" << Hex(ins.arg) << "ull);\n";
+                out << "    sp += 8;\n";
+            break;
+            case Opcode::cpl_u8:
+                out << "    stack.Set(sp, stack.GetU8(sp-" << Hex(ins.arg) << "ull));\n";
+                out << "    sp += 1;\n";
+            break;
+            case Opcode::cpg_u8:
+                out << "    stack.Set(sp, m.Load(" << Hex(ins.arg) << "ull));\n";
+                out << "    sp += 1;\n";
+            break;
+            case Opcode::cmp_u8:
+                out << "    stack.Set(sp-2, (u8)(stack.GetU8(sp-1) == stack.GetU8(sp-2)));\n";
+                out << "    sp -= 1;\n";
+            break;
+            case Opcode::pop_u8:
+                out << "    sp -= 1;\n";
+            break;
+            case Opcode::spd:
+                out << "    sp -= " << Hex(ins.arg) << "ull;\n";
+            break;
+            case Opcode::spi:
+                out << "    sp += " << Hex(ins.arg) << "ull;\n";
+            break;
+            case Opcode::set_u8:
+                out << "    m.Store(" << Hex(ins.arg) << "ull, stack.GetU8(sp-1));\n";
+                out << "    sp -= 1;\n";
+            break;
+            case Opcode::cas_u8:
+                out << "    {\n";
+                out << "        u8 expected = stack.GetU8(sp-2);\n";
+                out << "        bool swapped = m.Atomic(" << Hex(ins.arg) << "ull).compare_exchange_strong(expected, stack.GetU8(sp-1));\n";
+                out << "        stack.Set(sp-2, (u8)swapped);\n";
+                out << "    }\n";
+                out << "    sp -= 1;\n";
+            break;
+            case Opcode::fadd_u8:
+                out << "    stack.Set(sp-1, m.Atomic(" << Hex(ins.arg) << "ull).fetch_add(stack.GetU8(sp-1)));\n";
+            break;
+            case Opcode::fence:
+                out << "    std::atomic_thread_fence(std::memory_order_seq_cst);\n";
+            break;
+            case Opcode::halt:
+                out << "    m.sp = sp;\n";
+                out << "    return native_halt;\n";
+            break;
+        }
+    }
+
+    // falling off the end continues with whatever is loaded after the program
+    out << "    m.sp = sp;\n";
+    out << "    return " << Hex(offset + bin.size()) << ";\n";
+    out << "}\n\n";
+
+    out << "static NativeRegistration registration_" << name << "(\"" << name << "\", " << Hex(offset) << ", image_" << name << ", sizeof(image_" << name << "), &Native_" << name << ");\n";
+
+    return out.str();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4 && argc != 5)
+    {
+        std::cout << "Usage: " << std::filesystem::path(argv[0]).stem() << " outfile infile offset [name]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(argv[2], std::ifstream::binary);
+    if (!file)
+    {
+        std::cout << "Could not open " << argv[2] << std::endl;
+        return 1;
+    }
+    std::vector<u8> bin{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    file.close();
+
+    u64 offset = ArgHex(argv[3]);
+
+    std::string name = argc == 5 ? argv[4] : std::filesystem::path(argv[2]).stem().string();
+    for (char& c : name)
+    {
+        if (!std::isalnum((unsigned char)c))
+            c = '_';
+    }
+
+    std::string source = Translate(bin, offset, name);
+
+    std::cout << "Writing " << source.size() << " bytes" << std::endl;
+    std::ofstream outfile(argv[1]);
+    outfile << source;
+    outfile.close();
+
+    return 0;
+}
\ No newline at end of file
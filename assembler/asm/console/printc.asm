@@ -1,3 +1,4 @@
+offset:7D0
 set_u8 BB8
 push_u8 1
 set_u8 BB9
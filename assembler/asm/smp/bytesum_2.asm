@@ -0,0 +1,140 @@
+offset:0
+spi 1060
+push_u8 5B
+set_u8 B140
+push_u8 11
+set_u8 B141
+push_u8 20
+set_u8 B143
+:fill
+cpg_u8 B140
+cpg_u8 B140
+fadd_u8 B141
+pop_u8
+cpg_u8 B141
+cpg_u8 B141
+fadd_u8 B140
+pop_u8
+push_u8 FF
+fadd_u8 B142
+push_u8 1
+cmp_u8
+jmp_true :fill_seg
+jmp :fill
+:fill_seg
+push_u8 FF
+fadd_u8 B143
+push_u8 1
+cmp_u8
+jmp_true :start
+jmp :fill
+:start
+push_u64 :w1
+spd 6
+set_u8 BD5
+set_u8 BD4
+push_u8 1
+fadd_u8 BC3
+pop_u8
+:w0
+push_u8 FF
+set_u8 B003
+:w0_pass
+push_u8 20
+set_u8 B002
+:w0_byte
+cpl_u8 4000
+fadd_u8 B000
+pop_u8
+spi 1
+push_u8 FF
+fadd_u8 B001
+push_u8 1
+cmp_u8
+jmp_true :w0_seg
+jmp :w0_byte
+:w0_seg
+push_u8 FF
+fadd_u8 B002
+push_u8 1
+cmp_u8
+jmp_true :w0_next
+jmp :w0_byte
+:w0_next
+spd 2000
+push_u8 FF
+fadd_u8 B003
+push_u8 1
+cmp_u8
+jmp_true :w0_done
+jmp :w0_pass
+:w0_done
+cpg_u8 B000
+fadd_u8 B100
+pop_u8
+push_u8 1
+fadd_u8 B101
+pop_u8
+jmp :wait
+:w1
+spi 6D78
+push_u8 FF
+set_u8 B043
+:w1_pass
+push_u8 20
+set_u8 B042
+:w1_byte
+cpl_u8 4100
+fadd_u8 B040
+pop_u8
+spi 1
+push_u8 FF
+fadd_u8 B041
+push_u8 1
+cmp_u8
+jmp_true :w1_seg
+jmp :w1_byte
+:w1_seg
+push_u8 FF
+fadd_u8 B042
+push_u8 1
+cmp_u8
+jmp_true :w1_next
+jmp :w1_byte
+:w1_next
+spd 2000
+push_u8 FF
+fadd_u8 B043
+push_u8 1
+cmp_u8
+jmp_true :w1_done
+jmp :w1_pass
+:w1_done
+cpg_u8 B040
+fadd_u8 B100
+pop_u8
+push_u8 1
+fadd_u8 B101
+pop_u8
+halt
+:wait
+push_u8 0
+fadd_u8 B101
+push_u8 2
+cmp_u8
+jmp_true :result
+jmp :wait
+:result
+spd 5060
+:result_loop
+cpg_u8 B100
+push_u8 0
+cmp_u8
+jmp_true :end
+push_u8 FF
+fadd_u8 B100
+pop_u8
+spi 1
+jmp :result_loop
+:end
+halt
@@ -0,0 +1,236 @@
+offset:0
+spi 1060
+push_u8 5B
+set_u8 B140
+push_u8 11
+set_u8 B141
+push_u8 20
+set_u8 B143
+:fill
+cpg_u8 B140
+cpg_u8 B140
+fadd_u8 B141
+pop_u8
+cpg_u8 B141
+cpg_u8 B141
+fadd_u8 B140
+pop_u8
+push_u8 FF
+fadd_u8 B142
+push_u8 1
+cmp_u8
+jmp_true :fill_seg
+jmp :fill
+:fill_seg
+push_u8 FF
+fadd_u8 B143
+push_u8 1
+cmp_u8
+jmp_true :start
+jmp :fill
+:start
+push_u64 :w1
+spd 6
+set_u8 BD5
+set_u8 BD4
+push_u8 1
+fadd_u8 BC3
+pop_u8
+push_u64 :w2
+spd 6
+set_u8 BDD
+set_u8 BDC
+push_u8 1
+fadd_u8 BC4
+pop_u8
+push_u64 :w3
+spd 6
+set_u8 BE5
+set_u8 BE4
+push_u8 1
+fadd_u8 BC5
+pop_u8
+:w0
+push_u8 FF
+set_u8 B003
+:w0_pass
+push_u8 10
+set_u8 B002
+:w0_byte
+cpl_u8 4000
+fadd_u8 B000
+pop_u8
+spi 1
+push_u8 FF
+fadd_u8 B001
+push_u8 1
+cmp_u8
+jmp_true :w0_seg
+jmp :w0_byte
+:w0_seg
+push_u8 FF
+fadd_u8 B002
+push_u8 1
+cmp_u8
+jmp_true :w0_next
+jmp :w0_byte
+:w0_next
+spd 1000
+push_u8 FF
+fadd_u8 B003
+push_u8 1
+cmp_u8
+jmp_true :w0_done
+jmp :w0_pass
+:w0_done
+cpg_u8 B000
+fadd_u8 B100
+pop_u8
+push_u8 1
+fadd_u8 B101
+pop_u8
+jmp :wait
+:w1
+spi 5D78
+push_u8 FF
+set_u8 B043
+:w1_pass
+push_u8 10
+set_u8 B042
+:w1_byte
+cpl_u8 4100
+fadd_u8 B040
+pop_u8
+spi 1
+push_u8 FF
+fadd_u8 B041
+push_u8 1
+cmp_u8
+jmp_true :w1_seg
+jmp :w1_byte
+:w1_seg
+push_u8 FF
+fadd_u8 B042
+push_u8 1
+cmp_u8
+jmp_true :w1_next
+jmp :w1_byte
+:w1_next
+spd 1000
+push_u8 FF
+fadd_u8 B043
+push_u8 1
+cmp_u8
+jmp_true :w1_done
+jmp :w1_pass
+:w1_done
+cpg_u8 B040
+fadd_u8 B100
+pop_u8
+push_u8 1
+fadd_u8 B101
+pop_u8
+halt
+:w2
+spi 6A90
+push_u8 FF
+set_u8 B083
+:w2_pass
+push_u8 10
+set_u8 B082
+:w2_byte
+cpl_u8 4200
+fadd_u8 B080
+pop_u8
+spi 1
+push_u8 FF
+fadd_u8 B081
+push_u8 1
+cmp_u8
+jmp_true :w2_seg
+jmp :w2_byte
+:w2_seg
+push_u8 FF
+fadd_u8 B082
+push_u8 1
+cmp_u8
+jmp_true :w2_next
+jmp :w2_byte
+:w2_next
+spd 1000
+push_u8 FF
+fadd_u8 B083
+push_u8 1
+cmp_u8
+jmp_true :w2_done
+jmp :w2_pass
+:w2_done
+cpg_u8 B080
+fadd_u8 B100
+pop_u8
+push_u8 1
+fadd_u8 B101
+pop_u8
+halt
+:w3
+spi 77A8
+push_u8 FF
+set_u8 B0C3
+:w3_pass
+push_u8 10
+set_u8 B0C2
+:w3_byte
+cpl_u8 4300
+fadd_u8 B0C0
+pop_u8
+spi 1
+push_u8 FF
+fadd_u8 B0C1
+push_u8 1
+cmp_u8
+jmp_true :w3_seg
+jmp :w3_byte
+:w3_seg
+push_u8 FF
+fadd_u8 B0C2
+push_u8 1
+cmp_u8
+jmp_true :w3_next
+jmp :w3_byte
+:w3_next
+spd 1000
+push_u8 FF
+fadd_u8 B0C3
+push_u8 1
+cmp_u8
+jmp_true :w3_done
+jmp :w3_pass
+:w3_done
+cpg_u8 B0C0
+fadd_u8 B100
+pop_u8
+push_u8 1
+fadd_u8 B101
+pop_u8
+halt
+:wait
+push_u8 0
+fadd_u8 B101
+push_u8 4
+cmp_u8
+jmp_true :result
+jmp :wait
+:result
+spd 5060
+:result_loop
+cpg_u8 B100
+push_u8 0
+cmp_u8
+jmp_true :end
+push_u8 FF
+fadd_u8 B100
+pop_u8
+spi 1
+jmp :result_loop
+:end
+halt
@@ -0,0 +1,24 @@
+offset:0
+push_u64 :c1
+spd 6
+set_u8 BD5
+set_u8 BD4
+push_u8 1
+fadd_u8 BC3
+pop_u8
+push_u8 1
+fadd_u8 BC3
+pop_u8
+:wait
+cpg_u8 B000
+push_u8 1
+cmp_u8
+jmp_true :done
+jmp :wait
+:done
+halt
+:c1
+push_u8 1
+set_u8 B000
+:spin
+jmp :spin
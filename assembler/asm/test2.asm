@@ -1,3 +1,4 @@
+offset:0
 push_u64 1A
 push_u8 0
 push_u8 48
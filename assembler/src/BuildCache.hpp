@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Types.hpp"
+#include "Isa.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+// bump whenever the produced binary can change for the same source
+static constexpr char const* assembler_version = "asm-1";
+
+// content-addressed store of assembled binaries and their symbol tables.
+// entries are keyed on the source text together with the assembler version,
+// so an unchanged input costs one hash and one file read.
+//
+// an entry holds the full fingerprint it was built from next to the binary and its symbols.
+// the 64 bit key only names the file, a hit is confirmed by comparing fingerprints.
+// hits refresh the modification time, so Prune drops the least recently used entries first.
+class BuildCache
+{
+    std::filesystem::path dir;
+
+    static constexpr u64 fnv_offset = 14695981039346656037ull;
+    static constexpr u64 fnv_prime = 1099511628211ull;
+
+    static void WriteU64(std::ostream& out, u64 value)
+    {
+        for (u8 i = 0; i < 8; ++i)
+            out.put((char)(value >> (i*8)));
+    }
+
+    static bool ReadU64(std::istream& in, u64& value)
+    {
+        value = 0;
+        for (u8 i = 0; i < 8; ++i)
+        {
+            int c = in.get();
+            if (c == EOF)
+                return false;
+            value |= (u64)(u8)c << (i*8);
+        }
+        return true;
+    }
+
+    // unique per process and call so concurrent builds never share a temporary
+    static std::string TempSuffix()
+    {
+        static u64 const process = ((u64)std::random_device{}() << 32) | std::random_device{}();
+        static std::atomic<u64> counter = 0;
+        return "." + std::to_string(process) + "." + std::to_string(counter++) + ".tmp";
+    }
+
+    // writes through a temporary and renames, so readers see the old file or the whole new one
+    template<typename Writer>
+    bool WriteFile(std::filesystem::path const& path, Writer const& writer)
+    {
+        std::filesystem::path tmp = path;
+        tmp += TempSuffix();
+        std::ofstream file(tmp, std::ofstream::binary);
+        writer(file);
+        file.close();
+        if (!file)
+        {
+            std::cout << "Could not write cache file " << tmp << std::endl;
+            std::error_code ignored;
+            std::filesystem::remove(tmp, ignored);
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(tmp, path, error);
+        if (error)
+        {
+            std::cout << "Could not rename cache file to " << path << ": " << error.message() << std::endl;
+            std::error_code ignored;
+            std::filesystem::remove(tmp, ignored);
+            return false;
+        }
+        return true;
+    }
+
+public:
+    BuildCache(std::filesystem::path const& dir) :
+        dir(dir)
+    {}
+
+    // FNV-1a
+    static u64 Hash(std::string const& data, u64 hash = fnv_offset)
+    {
+        for (char c : data)
+        {
+            hash ^= (u8)c;
+            hash *= fnv_prime;
+        }
+        return hash;
+    }
+
+    // everything the output depends on. any isa change invalidates the cache.
+    static std::string Fingerprint(std::string const& source)
+    {
+        std::string fingerprint = assembler_version;
+        for (auto const& info : isa)
+        {
+            fingerprint += info.mnemonic;
+            fingerprint += (char)info.operand;
+        }
+        fingerprint += '\0';
+        fingerprint += source;
+        return fingerprint;
+    }
+
+    static std::string Key(std::string const& fingerprint)
+    {
+        u64 hash = Hash(fingerprint);
+
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string key(16, '0');
+        for (u8 i = 0; i < 16; ++i)
+            key[15-i] = digits[(hash >> (i*4)) & 0xF];
+        return key;
+    }
+
+    // writes the cached binary for fingerprint to outfile and fills labels. returns false on a miss.
+    bool Fetch(std::string const& key, std::string const& fingerprint, std::filesystem::path const& outfile, std::unordered_map<std::string, u64>& labels)
+    {
+        std::filesystem::path const path = dir / (key + ".entry");
+        std::ifstream entry(path, std::ifstream::binary);
+        if (!entry)
+            return false;
+
+        // layout: fingerprint size, fingerprint, binary size, binary, symbol count, then name size, name and address per symbol
+        u64 size = 0;
+        if (!ReadU64(entry, size) || size != fingerprint.size())
+            return false;
+        std::string stored(size, '\0');
+        if (!entry.read(stored.data(), size) || stored != fingerprint)
+            return false;
+        if (!ReadU64(entry, size))
+            return false;
+        std::vector<char> bin(size);
+        if (!entry.read(bin.data(), size))
+            return false;
+        u64 count = 0;
+        if (!ReadU64(entry, count))
+            return false;
+        labels.clear();
+        for (u64 i = 0; i < count; ++i)
+        {
+            u64 address = 0;
+            if (!ReadU64(entry, size))
+                return false;
+            std::string name(size, '\0');
+            if (!entry.read(name.data(), size) || !ReadU64(entry, address))
+                return false;
+            labels[name] = address;
+        }
+        entry.close();
+
+        std::ofstream out(outfile, std::ofstream::binary);
+        out.write(bin.data(), bin.size());
+        out.close();
+        if (!out)
+            return false;
+
+        std::error_code ignored;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), ignored);
+        return true;
+    }
+
+    void Store(std::string const& key, std::string const& fingerprint, std::vector<u8> const& bin, std::unordered_map<std::string, u64> const& labels)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(dir, error);
+        if (error)
+        {
+            std::cout << "Could not create cache directory " << dir << ": " << error.message() << std::endl;
+            return;
+        }
+
+        WriteFile(dir / (key + ".entry"), [&](std::ofstream& file) {
+            WriteU64(file, fingerprint.size());
+            file.write(fingerprint.data(), fingerprint.size());
+            WriteU64(file, bin.size());
+            file.write((char const*)bin.data(), bin.size());
+            WriteU64(file, labels.size());
+            for (auto const& label : labels)
+            {
+                WriteU64(file, label.first.size());
+                file.write(label.first.data(), label.first.size());
+                WriteU64(file, label.second);
+            }
+        });
+    }
+
+    // removes the least recently used entries until the cache holds at most maxBytes.
+    // temporaries older than a minute are left over from crashed builds and go too.
+    void Prune(u64 maxBytes)
+    {
+        struct Entry
+        {
+            std::filesystem::path path;
+            std::filesystem::file_time_type time;
+            u64 size;
+        };
+        std::vector<Entry> entries;
+        u64 total = 0;
+        auto const staleTemp = std::filesystem::file_time_type::clock::now() - std::chrono::minutes(1);
+
+        std::error_code error;
+        for (auto const& file : std::filesystem::directory_iterator(dir, error))
+        {
+            std::error_code ignored;
+            auto time = file.last_write_time(ignored);
+            if (file.path().extension() == ".tmp")
+            {
+                if (!ignored && time < staleTemp)
+                    std::filesystem::remove(file.path(), ignored);
+                continue;
+            }
+            if (file.path().extension() != ".entry")
+                continue;
+            u64 size = file.file_size(ignored);
+            if (ignored)
+                continue;
+            entries.push_back({file.path(), time, size});
+            total += size;
+        }
+
+        std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.time < b.time; });
+        for (auto const& entry : entries)
+        {
+            if (total <= maxBytes)
+                break;
+            std::error_code ignored;
+            if (std::filesystem::remove(entry.path, ignored))
+                total -= entry.size;
+        }
+    }
+};
@@ -1,4 +1,6 @@
 #include "DataWriter.hpp"
+#include "BuildCache.hpp"
+#include "Isa.hpp"
 
 #include <iostream>
 #include <vector>
@@ -9,26 +11,6 @@
 #include <unordered_map>
 #include <variant>
 
-static constexpr u8 opcode_size = 2;
-
-enum class Opcode
-{
-    // args | descr
-    jmp = 0, // addr | jump to addr
-    jmps, // - | jump to addr on stack. consumes addr.
-    jmp_true, // address | if byte on stack is 1, jump to address. consumes byte.
-    cmp_u8, // - | consumes two bytes from stack. pushes true on stack if equal. else false.
-    spi, // offset | increment sp
-    spd, // offset | decrease stackpointer
-    push_u8, // u8 | push byte on stack
-    push_u64,
-    pop_u8,
-    set_u8, // offset | set memory to u8 from stack
-    cpl_u8, // offset | copy relative(local) byte to stack
-    cpg_u8, // addr | copy absolute(global) byte to stack
-    halt, // stops machine
-};
-
 std::tuple<std::string::const_iterator, std::vector<std::string>> ParseRow(std::string::const_iterator rowBegin, std::string::const_iterator end)
 {
     auto isWhiteSpace = [](char const& c){ return c == ' ' || c == '\t' || c == '\n'; };
@@ -98,138 +80,41 @@ std::tuple<std::vector<u8>, std::vector<std::tuple<std::string, u64>>> AssembleO
     std::vector<std::tuple<std::string, u64>> labelOpenings;
 
     std::string const& opcode = tokens[0];
-    if (opcode == "jmp")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode jmp" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        auto addr = ParseArgU64(tokens[1]);
-        writer.Add((u16)Opcode::jmp);
-        if (std::holds_alternative<u64>(addr))
-            writer.Add(std::get<u64>(addr));
-        else
-        {
-            labelOpenings.push_back({std::get<std::string>(addr), writer.Pos()});
-            writer.Add((u64)0);
-        }
-    }
-    else if (opcode == "jmps")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode jmps" << std::endl;
-        ReqArgcount(tokens, 0, opcode);
-        writer.Add((u16)Opcode::jmps);
-    }
-    else if (opcode == "jmp_true")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode jmp_true" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        auto addr = ParseArgU64(tokens[1]);
-        writer.Add((u16)Opcode::jmp_true);
-        if (std::holds_alternative<u64>(addr))
-            writer.Add(std::get<u64>(addr));
-        else
-        {
-            labelOpenings.push_back({std::get<std::string>(addr), writer.Pos()});
-            writer.Add((u64)0);
-        }
-    }
-    else if (opcode == "cmp_u8")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode cmp_u8" << std::endl;
-        ReqArgcount(tokens, 0, opcode);
-        writer.Add((u16)Opcode::cmp_u8);
-    }
-    else if (opcode == "spi")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode spi" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        s64 offset = ArgHex(tokens[1]);
-        writer.Add((u16)Opcode::spi);
-        writer.Add(offset);
-    }
-    else if (opcode == "spd")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode spd" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        s64 offset = ArgHex(tokens[1]);
-        writer.Add((u16)Opcode::spd);
-        writer.Add(offset);
-    }
-    else if (opcode == "push_u8")
+    OpcodeInfo const* info = FindOpcode(opcode);
+    if (info == nullptr)
     {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode push_u8" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        u8 val = (u8)ArgHex(tokens[1]);
-        writer.Add((u16)Opcode::push_u8);
-        writer.Add(val);
+        auto msg = "Unknown opcode: "+opcode;
+        std::cout << msg << std::endl;
+        throw std::runtime_error(msg);
     }
-    else if (opcode == "push_u64")
+
+    if constexpr(showOpcodes)
+        std::cout << "Opcode " << info->mnemonic << std::endl;
+    ReqArgcount(tokens, info->operand == Operand::none ? 0 : 1, opcode);
+    writer.Add((u16)info->opcode);
+
+    switch(info->operand)
     {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode push_u64" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        auto val = ParseArgU64(tokens[1]);
-        writer.Add((u16)Opcode::push_u64);
-        if (std::holds_alternative<u64>(val))
-            writer.Add(std::get<u64>(val));
-        else
+        case Operand::none:
+        break;
+        case Operand::u8:
+            writer.Add((u8)ArgHex(tokens[1]));
+        break;
+        case Operand::u64:
+            writer.Add(ArgHex(tokens[1]));
+        break;
+        case Operand::label:
         {
-            labelOpenings.push_back({std::get<std::string>(val), writer.Pos()});
-            writer.Add((u64)0);
+            auto val = ParseArgU64(tokens[1]);
+            if (std::holds_alternative<u64>(val))
+                writer.Add(std::get<u64>(val));
+            else
+            {
+                labelOpenings.push_back({std::get<std::string>(val), writer.Pos()});
+                writer.Add((u64)0);
+            }
         }
-    }
-    else if (opcode == "pop_u8")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode pop_u8" << std::endl;
-        ReqArgcount(tokens, 0, opcode);
-        writer.Add((u16)Opcode::pop_u8);
-    }
-    else if (opcode == "set_u8")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode set_u8" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        u64 addr = ArgHex(tokens[1]);
-        writer.Add((u16)Opcode::set_u8);
-        writer.Add(addr);
-    }
-    else if (opcode == "cpl_u8")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode cpl_u8" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        u64 addr = ArgHex(tokens[1]);
-        writer.Add((u16)Opcode::cpl_u8);
-        writer.Add(addr);
-    }
-    else if (opcode == "cpg_u8")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode cpg_u8" << std::endl;
-        ReqArgcount(tokens, 1, opcode);
-        u64 addr = ArgHex(tokens[1]);
-        writer.Add((u16)Opcode::cpg_u8);
-        writer.Add(addr);
-    }
-    else if (opcode == "halt")
-    {
-        if constexpr(showOpcodes)
-            std::cout << "Opcode halt" << std::endl;
-        ReqArgcount(tokens, 0, opcode);
-        writer.Add((u16)Opcode::halt);
-    }
-    else
-    {
-        auto msg = "Unknown opcode: "+opcode;
-        std::cout << msg << std::endl;
-        throw std::runtime_error(msg);
+        break;
     }
     return {result, labelOpenings};
 }
@@ -275,20 +160,10 @@ std::tuple<std::string::const_iterator, std::string> ParseLabel(std::string::con
     return {labelEnd+1, label};
 }
 
-int main(int argc, char *argv[])
+std::tuple<std::vector<u8>, std::unordered_map<std::string, u64>> Assemble(std::string const& program)
 {
-    if (argc != 3)
-    {
-        std::cout << "Usage: " << std::experimental::filesystem::path(argv[0]).stem() << " outfile infile" << std::endl;
-        return 1;
-    }
-
     std::vector<u8> bin;
 
-    std::ifstream file(argv[2]);
-    std::string const program{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
-    file.close();
-
     auto progPos = program.begin();
 
     auto[newProgPos, globalOffset] = ParseOffset(progPos, program.end());
@@ -338,10 +213,136 @@ int main(int argc, char *argv[])
         }
     }
 
+    // symbol table holds absolute addresses, same as the patched label openings
+    for (auto& label : labels)
+        label.second += globalOffset;
+
+    return {bin, labels};
+}
+
+// writes the symbol table as "name address" lines, addresses in hex
+void WriteSymbols(std::filesystem::path const& path, std::unordered_map<std::string, u64> const& labels)
+{
+    std::vector<std::pair<std::string, u64>> sorted(labels.begin(), labels.end());
+    std::sort(sorted.begin(), sorted.end());
+    std::ofstream file(path);
+    for (auto const& label : sorted)
+        file << label.first << " " << std::hex << std::uppercase << label.second << std::dec << "\n";
+    file.close();
+    if (!file)
+    {
+        std::string msg = "Could not write " + path.string();
+        std::cout << msg << std::endl;
+        throw std::runtime_error(msg);
+    }
+}
+
+void AssembleFile(BuildCache& cache, std::filesystem::path const& outfile, std::filesystem::path const& infile, bool symbols)
+{
+    std::ifstream file(infile);
+    if (!file)
+    {
+        std::string msg = "Could not open " + infile.string();
+        std::cout << msg << std::endl;
+        throw std::runtime_error(msg);
+    }
+    std::string const program{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    file.close();
+
+    std::string const fingerprint = BuildCache::Fingerprint(program);
+    std::string const key = BuildCache::Key(fingerprint);
+    std::unordered_map<std::string, u64> cached;
+    if (cache.Fetch(key, fingerprint, outfile, cached))
+    {
+        std::cout << "Cached " << infile.string() << std::endl;
+        if (symbols)
+            WriteSymbols(std::filesystem::path(outfile).replace_extension(".sym"), cached);
+        return;
+    }
+
+    auto[bin, labels] = Assemble(program);
+
     std::cout << "Writing " << bin.size() << " bytes" << std::endl;
-    std::ofstream outfile (argv[1],std::ofstream::binary);
-    outfile.write((char const*)bin.data(), bin.size());
-    outfile.close();
+    std::ofstream out(outfile, std::ofstream::binary);
+    out.write((char const*)bin.data(), bin.size());
+    out.close();
+    if (symbols)
+        WriteSymbols(std::filesystem::path(outfile).replace_extension(".sym"), labels);
 
-    return 0;
-}
\ No newline at end of file
+    cache.Store(key, fingerprint, bin, labels);
+}
+
+int main(int argc, char *argv[])
+{
+    std::filesystem::path cacheDir = ".asmcache";
+    u64 cacheLimit = 64 << 20;
+    bool batch = false;
+    bool symbols = false;
+
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-')
+    {
+        std::string option = argv[arg];
+        if (option == "--cache" && arg+1 < argc)
+        {
+            cacheDir = argv[arg+1];
+            arg += 2;
+        }
+        else if (option == "--cache-limit" && arg+1 < argc)
+        {
+            cacheLimit = std::stoull(argv[arg+1]);
+            arg += 2;
+        }
+        else if (option == "--batch")
+        {
+            batch = true;
+            arg += 1;
+        }
+        else if (option == "--symbols")
+        {
+            symbols = true;
+            arg += 1;
+        }
+        else
+            break;
+    }
+
+    if ((batch && arg >= argc) || (!batch && argc-arg != 2))
+    {
+        std::cout << "Usage: " << std::filesystem::path(argv[0]).stem() << " [options] outfile infile" << std::endl;
+        std::cout << "       " << std::filesystem::path(argv[0]).stem() << " [options] --batch infile..." << std::endl;
+        std::cout << "--cache dir          cache directory, default .asmcache" << std::endl;
+        std::cout << "--cache-limit bytes  least recently used entries are dropped above this, default 64 MiB" << std::endl;
+        std::cout << "--symbols            also writes the symbol table next to each outfile as .sym" << std::endl;
+        return 1;
+    }
+
+    BuildCache cache(cacheDir);
+
+    if (!batch)
+    {
+        AssembleFile(cache, argv[arg+0], argv[arg+1], symbols);
+        cache.Prune(cacheLimit);
+        return 0;
+    }
+
+    // batch mode writes each infile next to itself with a .bin extension
+    int failures = 0;
+    for (; arg < argc; ++arg)
+    {
+        std::filesystem::path infile = argv[arg];
+        try
+        {
+            AssembleFile(cache, std::filesystem::path(infile).replace_extension(".bin"), infile, symbols);
+        }
+        catch (std::exception const&)
+        {
+            std::cout << "Failed to assemble " << infile.string() << std::endl;
+            ++failures;
+        }
+    }
+
+    cache.Prune(cacheLimit);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#!/bin/bash
+# byte-sum benchmark. sums the same 16 KiB buffer 255 times on 1, 2 and 4 guest cores,
+# checks every run against the expected checksum and reports the best time per core count.
+# the guests leave the checksum in sp, which the vm prints at halt.
+#
+# usage: bench.sh [runs] [workdir]
+set -e
+
+root=$(cd "$(dirname "$0")" && pwd)
+runs=${1:-5}
+work=${2:-$root/build/bench}
+mkdir -p "$work"
+work=$(cd "$work" && pwd)
+
+build()
+{
+    cmake -S "$1" -B "$2" -DCMAKE_BUILD_TYPE=Release > /dev/null
+    cmake --build "$2" > /dev/null
+}
+
+build "$root" "$work/vm"
+build "$root/assembler" "$work/assembler"
+vm=$work/vm/bin/vm
+
+# the guests fill the buffer with a fibonacci sequence mod 256 seeded with 5B, 11
+expected()
+{
+    local x=$((0x5B)) y=$((0x11)) sum=0 i
+    for ((i = 0; i < 0x4000/2; ++i)); do
+        y=$(((y+x) & 255))
+        sum=$((sum+x+y))
+        x=$(((x+y) & 255))
+    done
+    echo $((sum*255 & 255))
+}
+checksum=$(expected)
+
+cpus=$(nproc 2>/dev/null || echo 1)
+echo "host cpus: $cpus, expected checksum: $checksum"
+if [ "$cpus" -lt 5 ]; then
+    # the console peripheral spins on its own thread, so 4 guest cores want 5 host cpus
+    echo "fewer host cpus than guest cores plus the console thread. times will not show scaling."
+fi
+printf "%-6s %10s %8s\n" cores "best ms" speedup
+
+base=
+for cores in 1 2 4; do
+    bin=$work/bytesum_$cores.bin
+    "$work/assembler/bin/assembler" --cache "$work/asmcache" "$bin" "$root/assembler/asm/smp/bytesum_$cores.asm" > /dev/null
+
+    best=
+    for ((run = 0; run < runs; ++run)); do
+        start=$(date +%s%N)
+        out=$("$vm" "$bin" "$root/assembler/asm")
+        end=$(date +%s%N)
+        sum=$(echo "$out" | sed -n 's/^sp: //p')
+        if [ "$sum" != "$checksum" ]; then
+            echo "bytesum_$cores: checksum $sum, expected $checksum"
+            exit 1
+        fi
+        ms=$(((end-start) / 1000000))
+        if [ -z "$best" ] || [ $ms -lt $best ]; then
+            best=$ms
+        fi
+    done
+
+    base=${base:-$best}
+    printf "%-6s %10s %8s\n" $cores $best $(awk "BEGIN { printf \"%.2f\", $base / ($best ? $best : 1) }")
+done
@@ -0,0 +1,160 @@
+#!/bin/bash
+# differential test of the aot translator against the interpreter.
+# every guest runs on the vm and as a native aot build, and both stdouts
+# (console output, halt and the final sp) must match.
+# it also checks that the assembler build cache hits and misses when it should,
+# and that disassembling a guest and assembling it again gives the same binary.
+#
+# usage: difftest.sh [workdir] [vm]
+# without vm the interpreter is built into workdir as well.
+set -e
+
+root=$(cd "$(dirname "$0")" && pwd)
+work=${1:-$root/build/difftest}
+mkdir -p "$work"
+work=$(cd "$work" && pwd)
+vm=$2
+
+build()
+{
+    cmake -S "$1" -B "$2" -DCMAKE_BUILD_TYPE=Release > /dev/null
+    cmake --build "$2" > /dev/null
+}
+
+# the load offset is the first line of every guest source
+offset()
+{
+    sed -n '1s/^offset:\([0-9A-Fa-f]*\).*$/\1/p' "$1"
+}
+
+assemble()
+{
+    "$assembler" --cache "$work/asmcache" "$2" "$1" > /dev/null
+}
+
+# translates a guest and compiles it to an object file
+native()
+{
+    "$aot" "$2.cpp" "$1" "$(offset "$3")" "$4" > /dev/null
+    ${CXX:-c++} -std=c++20 -O2 -I"$root/aot/runtime" -I"$root/include" -c "$2.cpp" -o "$2.o"
+}
+
+if [ -z "$vm" ]; then
+    build "$root" "$work/vm"
+    vm=$work/vm/bin/vm
+fi
+build "$root/assembler" "$work/assembler"
+build "$root/aot" "$work/aot"
+build "$root/disassembler" "$work/disassembler"
+assembler=$work/assembler/bin/assembler
+aot=$work/aot/bin/aot
+disassembler=$work/disassembler/bin/disassembler
+
+# the console library the vm loads next to every guest
+lib=$work/lib
+mkdir -p "$lib/console"
+for name in printc printcstr; do
+    assemble "$root/assembler/asm/console/$name.asm" "$lib/console/$name.bin"
+    native "$lib/console/$name.bin" "$lib/$name" "$root/assembler/asm/console/$name.asm" "$name"
+done
+
+failures=0
+check()
+{
+    local name=$1 asm=$root/$2 dir=$work/$1
+    mkdir -p "$dir"
+    assemble "$asm" "$dir/guest.bin"
+    native "$dir/guest.bin" "$dir/guest" "$asm" guest
+    ${CXX:-c++} "$dir/guest.o" "$lib/printc.o" "$lib/printcstr.o" "$work/aot/libaotrt.a" -pthread -o "$dir/native"
+
+    timeout 60 "$vm" "$dir/guest.bin" "$lib" > "$dir/vm.out" || true
+    timeout 60 "$dir/native" > "$dir/native.out" || true
+
+    if ! grep -q '^sp: ' "$dir/vm.out"; then
+        echo "FAIL $name: interpreter did not halt"
+        failures=$((failures+1))
+    elif ! diff -u "$dir/vm.out" "$dir/native.out"; then
+        echo "FAIL $name"
+        failures=$((failures+1))
+    else
+        echo "PASS $name"
+    fi
+}
+
+# assembler build cache: a miss, a hit with identical output, and a miss once the source changes
+cachecheck()
+{
+    local dir=$work/cachecheck
+    rm -rf "$dir"
+    mkdir -p "$dir"
+    cp "$root/assembler/asm/smp/bytesum_1.asm" "$dir/guest.asm"
+    cached()
+    {
+        "$assembler" --cache "$dir/cache" --symbols "$dir/$1.bin" "$dir/guest.asm" | grep -q '^Cached'
+    }
+
+    if cached miss; then
+        echo "FAIL cache: hit on an empty cache"
+    elif ! cached hit; then
+        echo "FAIL cache: miss on an unchanged source"
+    elif ! cmp -s "$dir/miss.bin" "$dir/hit.bin" || ! cmp -s "$dir/miss.sym" "$dir/hit.sym"; then
+        echo "FAIL cache: hit differs from the assembled output"
+    elif printf '\nhalt\n' >> "$dir/guest.asm" && cached changed; then
+        echo "FAIL cache: hit on a changed source"
+    else
+        echo "PASS cache"
+        return
+    fi
+    failures=$((failures+1))
+}
+
+# disassembles a guest, assembles the result and compares both binaries
+roundtrip()
+{
+    local name=$1 asm=$root/$2 dir=$work/roundtrip/$1
+    mkdir -p "$dir"
+    assemble "$asm" "$dir/guest.bin"
+    if ! "$disassembler" "$dir/guest.asm" "$dir/guest.bin" "$(offset "$asm")" > /dev/null; then
+        echo "FAIL roundtrip $name: could not disassemble"
+    elif ! assemble "$dir/guest.asm" "$dir/again.bin"; then
+        echo "FAIL roundtrip $name: could not assemble the disassembly"
+    elif ! cmp -s "$dir/guest.bin" "$dir/again.bin"; then
+        echo "FAIL roundtrip $name: binaries differ"
+    else
+        echo "PASS roundtrip $name"
+        return
+    fi
+    failures=$((failures+1))
+}
+
+# a binary cut inside an instruction is reported, not crashed on
+truncated()
+{
+    local dir=$work/roundtrip/truncated rc=0
+    mkdir -p "$dir"
+    assemble "$root/assembler/asm/test2.asm" "$dir/guest.bin"
+    head -c -1 "$dir/guest.bin" > "$dir/cut.bin"
+    "$disassembler" - "$dir/cut.bin" "$(offset "$root/assembler/asm/test2.asm")" > "$dir/out" || rc=$?
+    if [ $rc -ne 1 ]; then
+        echo "FAIL truncated: exit code $rc"
+        failures=$((failures+1))
+    else
+        echo "PASS truncated"
+    fi
+}
+
+cachecheck
+roundtrip printc assembler/asm/console/printc.asm
+roundtrip printcstr assembler/asm/console/printcstr.asm
+roundtrip test2 assembler/asm/test2.asm
+roundtrip bytesum_1 assembler/asm/smp/bytesum_1.asm
+roundtrip bytesum_4 assembler/asm/smp/bytesum_4.asm
+truncated
+check test2 assembler/asm/test2.asm
+check bytesum_1 assembler/asm/smp/bytesum_1.asm
+check bytesum_4 assembler/asm/smp/bytesum_4.asm
+# core 0 starts core 1 twice before the first poll, core 1 then spins forever
+# and core 0 halts. the start must be seen and the machine must stop anyway.
+check stop assembler/asm/smp/stop.asm
+
+[ $failures -eq 0 ]
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Types.hpp"
+
+#include <string>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// read-only view of a whole file. the input is never copied.
+class MappedFile
+{
+    u8 const* data = nullptr;
+    u64 size = 0;
+    bool valid = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+public:
+    MappedFile(std::string const& path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER length;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &length))
+            return;
+        size = (u64)length.QuadPart;
+        valid = true;
+        // empty files cannot be mapped
+        if (size == 0)
+            return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr)
+            data = (u8 const*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        valid = data != nullptr;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        struct stat info;
+        if (fstat(fd, &info) == 0)
+        {
+            size = (u64)info.st_size;
+            valid = true;
+            if (size != 0)
+            {
+                void* memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                valid = memory != MAP_FAILED;
+                if (valid)
+                {
+                    data = (u8 const*)memory;
+                    madvise(memory, size, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    ~MappedFile()
+    {
+#ifdef _WIN32
+        if (data != nullptr)
+            UnmapViewOfFile(data);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#else
+        if (data != nullptr)
+            munmap((void*)data, size);
+#endif
+    }
+
+    bool Valid() const
+    {
+        return valid;
+    }
+
+    u8 const* Data() const
+    {
+        return data;
+    }
+
+    u64 Size() const
+    {
+        return size;
+    }
+};
@@ -0,0 +1,344 @@
+#include "Types.hpp"
+#include "Isa.hpp"
+#include "MappedFile.hpp"
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+
+// longest line per opcode: mnemonic, space, ":L_" and 16 hex digits, newline
+static constexpr std::array<u8, opcode_count> max_line = []() {
+    std::array<u8, opcode_count> length{};
+    for (auto const& info : isa)
+        length[(u64)info.opcode] = (u8)(info.mnemonic.size() + (info.operand == Operand::none ? 0 : 1 + 3 + 16) + 1);
+    return length;
+}();
+static constexpr u64 max_label_line = 3 + 16 + 1;
+
+// how the line of an opcode is printed. lets the print loop go without branching on the operand.
+struct LineFormat
+{
+    // the mnemonic followed by a space, or by the newline if it takes no operand.
+    // padded so it is always copied as 16 bytes.
+    char prefix[16];
+    u8 length;
+    bool operand;
+    bool label;
+    u64 mask; // operand bits of the 8 bytes behind the opcode
+};
+static constexpr std::array<LineFormat, opcode_count> formats = []() {
+    std::array<LineFormat, opcode_count> result{};
+    for (auto const& info : isa)
+    {
+        LineFormat& format = result[(u64)info.opcode];
+        std::copy(info.mnemonic.begin(), info.mnemonic.end(), format.prefix);
+        format.prefix[info.mnemonic.size()] = info.operand == Operand::none ? '\n' : ' ';
+        format.length = (u8)(info.mnemonic.size() + 1);
+        format.operand = info.operand != Operand::none;
+        format.label = info.operand == Operand::label;
+        format.mask = info.OperandSize() == 8 ? ~(u64)0 : ((u64)1 << (info.OperandSize() * 8)) - 1;
+    }
+    return result;
+}();
+static_assert(std::all_of(isa, isa + opcode_count, [](OpcodeInfo const& info) { return info.mnemonic.size() < 16; }), "mnemonic too long");
+
+// the writers below always store 16 bytes and advance by less
+static constexpr u64 store_slack = 16;
+
+u64 ArgHex(std::string const& hex)
+{
+    return std::stoul(hex, nullptr, 16);
+}
+
+inline u64 ReadU64(u8 const* p)
+{
+    u64 value = 0;
+    for (u8 i = 0; i < 8; ++i)
+        value |= (u64)p[i] << (i*8);
+    return value;
+}
+
+// the 8 bytes at pos, zero past the end of the input
+inline u64 ReadOperand(u8 const* data, u64 size, u64 pos)
+{
+    if (pos + 8 <= size)
+        return ReadU64(data + pos);
+    u64 value = 0;
+    for (u64 i = 0; pos + i < size; ++i)
+        value |= (u64)data[pos + i] << (i*8);
+    return value;
+}
+
+inline u64 ByteSwap(u64 value)
+{
+    value = ((value & 0x00FF00FF00FF00FFull) << 8) | ((value >> 8) & 0x00FF00FF00FF00FFull);
+    value = ((value & 0x0000FFFF0000FFFFull) << 16) | ((value >> 16) & 0x0000FFFF0000FFFFull);
+    return (value << 32) | (value >> 32);
+}
+
+// the 8 nibbles of value as hex digits, most significant first in memory
+inline u64 HexDigits(u32 value)
+{
+    u64 x = value;
+    x = ((x << 16) | x) & 0x0000FFFF0000FFFFull;
+    x = ((x << 8) | x) & 0x00FF00FF00FF00FFull;
+    x = ((x << 4) | x) & 0x0F0F0F0F0F0F0F0Full;
+    // '0' for every nibble, plus the gap to 'A' for nibbles above 9
+    x += 0x3030303030303030ull + (((x + 0x0606060606060606ull) >> 4) & 0x0101010101010101ull) * 7;
+    if constexpr (std::endian::native == std::endian::little)
+        x = ByteSwap(x);
+    return x;
+}
+
+// writes value without leading zeros. stores 16 bytes.
+inline char* WriteHex(char* out, u64 value)
+{
+    u8 count = (u8)((std::bit_width(value | 1) + 3) / 4);
+    // moves the leading digit to the top so the digits start at out
+    value <<= (16 - count) * 4;
+    u64 high = HexDigits((u32)(value >> 32));
+    u64 low = HexDigits((u32)value);
+    std::memcpy(out, &high, 8);
+    std::memcpy(out + 8, &low, 8);
+    return out + count;
+}
+
+inline char* WriteLabel(char* out, u64 addr)
+{
+    *out++ = ':';
+    *out++ = 'L';
+    *out++ = '_';
+    return WriteHex(out, addr);
+}
+
+// one bit per input byte
+class BitSet
+{
+    std::vector<u64> words;
+public:
+    BitSet(u64 size) :
+        words((size + 63) / 64, 0)
+    {
+    }
+
+    void Set(u64 pos)
+    {
+        words[pos / 64] |= (u64)1 << (pos % 64);
+    }
+
+    // replaces the word that holds pos
+    void SetWord(u64 pos, u64 bits)
+    {
+        words[pos / 64] = bits;
+    }
+
+    bool Test(u64 pos) const
+    {
+        return (words[pos / 64] >> (pos % 64)) & 1;
+    }
+
+    BitSet& operator&=(BitSet const& other)
+    {
+        for (u64 i = 0; i < words.size(); ++i)
+            words[i] &= other.words[i];
+        return *this;
+    }
+};
+
+// pass one. finds instruction starts and label operands, and rejects input that does not decode.
+// returns where labels go: targets that land on an instruction.
+BitSet Scan(u8 const* data, u64 size, u64 offset)
+{
+    BitSet starts(size);
+    BitSet targets(size);
+    // starts come in order, so the word being filled stays in a register and is stored whole
+    u64 bits = 0;
+    u64 word = 0;
+
+    u64 pos = 0;
+    while (pos < size)
+    {
+        u16 opcode = pos + opcode_size <= size ? (u16)(data[pos] | (data[pos+1] << 8)) : 0xFFFF;
+        u8 length = opcode_length[opcode];
+        if (length == 0 || pos + length > size)
+        {
+            std::string msg = "Cannot decode instruction at " + std::to_string(offset+pos);
+            std::cout << msg << std::endl;
+            throw std::runtime_error(msg);
+        }
+        bits = (pos / 64 == word ? bits : 0) | (u64)1 << (pos % 64);
+        word = pos / 64;
+        starts.SetWord(pos, bits);
+        if (formats[opcode].label)
+        {
+            u64 target = ReadU64(data + pos + opcode_size) - offset;
+            if (target < size)
+                targets.Set(target);
+        }
+        pos += length;
+    }
+    targets &= starts;
+    return targets;
+}
+
+// fixed size buffer written to the file in chunks
+class Output
+{
+    static constexpr u64 chunk_size = 1 << 20;
+
+    std::FILE* file;
+    std::unique_ptr<char[]> buffer;
+    u64 written = 0;
+public:
+    // the longest text one instruction can produce, including its label line
+    static constexpr u64 max_entry = max_label_line + *std::max_element(max_line.begin(), max_line.end()) + store_slack;
+
+    Output(std::FILE* file) :
+        file(file),
+        buffer(new char[chunk_size])
+    {
+    }
+
+    char* Begin()
+    {
+        return buffer.get();
+    }
+
+    // true if another instruction might not fit behind cursor
+    bool Full(char const* cursor) const
+    {
+        return buffer.get() + chunk_size - cursor < (std::ptrdiff_t)max_entry;
+    }
+
+    // writes everything before cursor. returns the cursor to continue with.
+    char* Flush(char* cursor)
+    {
+        u64 count = cursor - buffer.get();
+        if (std::fwrite(buffer.get(), 1, count, file) != count)
+        {
+            std::string msg = "Could not write output";
+            std::cout << msg << std::endl;
+            throw std::runtime_error(msg);
+        }
+        written += count;
+        return buffer.get();
+    }
+
+    u64 Written() const
+    {
+        return written;
+    }
+};
+
+// pass two. emits assembly the assembler turns back into the same binary.
+void Print(u8 const* data, u64 size, u64 offset, BitSet const& labels, Output& output)
+{
+    char* cursor = output.Begin();
+
+    static constexpr char header[] = "offset:";
+    cursor = std::copy(header, header + sizeof(header) - 1, cursor);
+    cursor = WriteHex(cursor, offset);
+    *cursor++ = '\n';
+
+    u64 pos = 0;
+    while (pos < size)
+    {
+        if (output.Full(cursor))
+            cursor = output.Flush(cursor);
+
+        if (labels.Test(pos))
+        {
+            cursor = WriteLabel(cursor, offset + pos);
+            *cursor++ = '\n';
+        }
+
+        u16 opcode = (u16)(data[pos] | (data[pos+1] << 8));
+        LineFormat const& format = formats[opcode];
+        std::memcpy(cursor, format.prefix, sizeof(format.prefix));
+        cursor += format.length;
+
+        // the operand is always printed and only kept if the opcode has one
+        u64 value = ReadOperand(data, size, pos + opcode_size) & format.mask;
+        u64 target = value - offset;
+        bool inside = target < size;
+        bool label = format.label & inside & labels.Test(inside ? target : 0);
+        std::memcpy(cursor, ":L_", 3);
+        char* end = WriteHex(cursor + (label ? 3 : 0), value);
+        *end = '\n';
+        cursor = format.operand ? end + 1 : cursor;
+
+        pos += opcode_length[opcode];
+    }
+    output.Flush(cursor);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        std::cout << "Usage: " << std::filesystem::path(argv[0]).stem() << " outfile infile offset" << std::endl;
+        std::cout << "outfile - writes to stdout" << std::endl;
+        return 1;
+    }
+
+    MappedFile bin(argv[2]);
+    if (!bin.Valid())
+    {
+        std::cout << "Could not open " << argv[2] << std::endl;
+        return 1;
+    }
+    u64 offset = ArgHex(argv[3]);
+    // the error is already printed, with the offset of the instruction
+    std::optional<BitSet> labels;
+    try
+    {
+        labels.emplace(Scan(bin.Data(), bin.Size(), offset));
+    }
+    catch (std::runtime_error const&)
+    {
+        return 1;
+    }
+
+    bool toStdout = std::string(argv[1]) == "-";
+    std::FILE* file = toStdout ? stdout : std::fopen(argv[1], "wb");
+    if (file == nullptr)
+    {
+        std::cout << "Could not open " << argv[1] << std::endl;
+        return 1;
+    }
+    // output is already written in large chunks
+    std::setvbuf(file, nullptr, _IONBF, 0);
+
+    Output output(file);
+    try
+    {
+        Print(bin.Data(), bin.Size(), offset, *labels, output);
+    }
+    catch (std::runtime_error const&)
+    {
+        if (!toStdout)
+            std::fclose(file);
+        return 1;
+    }
+
+    if (toStdout)
+        return 0;
+
+    if (std::fclose(file) != 0)
+    {
+        std::cout << "Could not write " << argv[1] << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << output.Written() << " bytes" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Layout.hpp"
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+// starts the guest cores other than core 0, each on its own host thread.
+// the vm and the aot runtime share it and only differ in how a core runs.
+//
+// a guest writes the pc to IO_CORE_PC+core*8, then adds to IO_CORE_START+core with fadd_u8
+// or cas_u8. every core starts once, later starts are ignored.
+// core 0 halting stops the machine: Stop sets Stopping(), which the running cores check
+// regularly and then return.
+//
+// runCore(core, pc, stopping) runs one core. it returns false if the core failed.
+template<typename RunCore>
+class PeripheralCores
+{
+    std::uint8_t* memory;
+    RunCore runCore;
+    std::thread runner;
+    std::atomic<bool> stopping = false;
+    std::atomic<bool> failed = false;
+    std::vector<bool> started;
+    std::vector<std::thread> cores;
+
+    void Poll()
+    {
+        for (std::uint64_t core = 1; core < core_count; ++core)
+        {
+            // any nonzero value is a start. a guest adding twice before the poll leaves 2.
+            std::atomic_ref<std::uint8_t> start(memory[IO_CORE_START+core]);
+            if (start.exchange(0, std::memory_order_acquire) == 0 || started[core])
+                continue;
+            started[core] = true;
+
+            std::uint64_t pc = 0;
+            for (std::uint64_t i = 0; i < 8; ++i)
+                pc |= (std::uint64_t)memory[IO_CORE_PC+core*8+i] << (i*8);
+            cores.emplace_back([this, core, pc]() {
+                if (!runCore(core, pc, stopping))
+                    failed = true;
+            });
+        }
+    }
+public:
+    PeripheralCores(std::uint8_t* memory, RunCore runCore) :
+        memory(memory),
+        runCore(runCore),
+        started(core_count, false)
+    {
+        for (std::uint64_t core = 0; core < core_count; ++core)
+            memory[IO_CORE_START+core] = 0;
+    }
+
+    std::atomic<bool> const& Stopping() const
+    {
+        return stopping;
+    }
+
+    void Start()
+    {
+        runner = std::thread([this]() {
+            while(!stopping.load(std::memory_order_relaxed))
+            {
+                Poll();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+
+    // called once core 0 halted. stops the other cores and waits for them.
+    // returns false if one of them failed.
+    bool Stop()
+    {
+        stopping = true;
+        runner.join();
+        for (auto& core : cores)
+            core.join();
+        return !failed;
+    }
+};
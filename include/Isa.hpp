@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string_view>
+#include <algorithm>
+#include <utility>
+
+// single description of the instruction set. the vm, assembler, aot translator
+// and disassembler all derive their tables from this.
+
+static constexpr std::uint8_t opcode_size = 2;
+
+// the instruction set in opcode order: name, operand, flags.
+// expanded into the Opcode enum and the isa table below, and by tools that need one case per opcode.
+#define ISA_OPCODES(X) \
+    X(jmp,      label, flag_control)                    /* addr | jump to addr */ \
+    X(jmps,     none,  flag_control)                    /* - | jump to addr on stack. consumes addr. */ \
+    X(jmp_true, label, flag_control | flag_conditional) /* address | if byte on stack is 1, jump to address. consumes byte. */ \
+    X(cmp_u8,   none,  flag_none)                       /* - | consumes two bytes from stack. pushes true on stack if equal. else false. */ \
+    X(spi,      u64,   flag_none)                       /* offset | increment sp */ \
+    X(spd,      u64,   flag_none)                       /* offset | decrease stackpointer */ \
+    X(push_u8,  u8,    flag_none)                       /* u8 | push byte on stack */ \
+    X(push_u64, label, flag_none)                       /* u64 | push 8 bytes on stack */ \
+    X(pop_u8,   none,  flag_none)                       /* - | drop byte from stack */ \
+    X(set_u8,   u64,   flag_none)                       /* offset | set memory to u8 from stack */ \
+    X(cpl_u8,   u64,   flag_none)                       /* offset | copy relative(local) byte to stack */ \
+    X(cpg_u8,   u64,   flag_none)                       /* addr | copy absolute(global) byte to stack */ \
+    X(halt,     none,  flag_control)                    /* - | stops the core. on core 0 it stops the machine, including the other cores. */ \
+    X(cas_u8,   u64,   flag_none)                       /* addr | consumes expected and desired bytes from stack. atomically sets addr to desired if it holds expected. pushes true on success. else false. */ \
+    X(fadd_u8,  u64,   flag_none)                       /* addr | consumes byte from stack. atomically adds it to addr. pushes the previous value. */ \
+    X(fence,    none,  flag_none)                       /* - | full memory fence */
+
+enum class Opcode
+{
+#define ISA_ENUM(name, operand, flags) name,
+    ISA_OPCODES(ISA_ENUM)
+#undef ISA_ENUM
+};
+
+enum class Operand
+{
+    none,
+    u8,
+    u64,
+    label, // u64 that may be written as :label in assembly
+};
+
+enum OpcodeFlags : std::uint8_t
+{
+    flag_none = 0,
+    flag_control = 1, // sets pc itself instead of falling through
+    flag_conditional = 2, // control flow that may also fall through
+};
+
+struct OpcodeInfo
+{
+    Opcode opcode;
+    std::string_view mnemonic;
+    Operand operand;
+    std::uint8_t flags;
+
+    constexpr std::uint8_t OperandSize() const
+    {
+        switch(operand)
+        {
+            case Operand::u8: return 1;
+            case Operand::u64: return 8;
+            case Operand::label: return 8;
+            default: return 0;
+        }
+    }
+
+    constexpr std::uint8_t Size() const
+    {
+        return opcode_size + OperandSize();
+    }
+};
+
+// indexed by opcode
+static constexpr OpcodeInfo isa[] = {
+#define ISA_INFO(name, operand, flags) {Opcode::name, #name, Operand::operand, flags},
+    ISA_OPCODES(ISA_INFO)
+#undef ISA_INFO
+};
+
+static constexpr std::size_t opcode_count = std::size(isa);
+
+static_assert([]() {
+    for (std::size_t i = 0; i < opcode_count; ++i)
+    {
+        if ((std::size_t)isa[i].opcode != i)
+            return false;
+    }
+    return true;
+}(), "isa must be ordered by opcode");
+
+// total instruction length per opcode. 0 for invalid opcodes, so decoders can index it with any u16.
+static constexpr std::array<std::uint8_t, 0x10000> opcode_length = []() {
+    std::array<std::uint8_t, 0x10000> length{};
+    for (auto const& info : isa)
+        length[(std::size_t)info.opcode] = info.Size();
+    return length;
+}();
+
+// mnemonics sorted for binary search by the assembler
+static constexpr std::array<OpcodeInfo, opcode_count> isa_by_mnemonic = []() {
+    std::array<OpcodeInfo, opcode_count> sorted{};
+    std::copy(std::begin(isa), std::end(isa), sorted.begin());
+    std::sort(sorted.begin(), sorted.end(), [](OpcodeInfo const& a, OpcodeInfo const& b) { return a.mnemonic < b.mnemonic; });
+    return sorted;
+}();
+
+constexpr OpcodeInfo const* FindOpcode(std::string_view mnemonic)
+{
+    auto it = std::lower_bound(isa_by_mnemonic.begin(), isa_by_mnemonic.end(), mnemonic, [](OpcodeInfo const& info, std::string_view m) { return info.mnemonic < m; });
+    if (it == isa_by_mnemonic.end() || it->mnemonic != mnemonic)
+        return nullptr;
+    return &*it;
+}
+
+static_assert(FindOpcode("jmp_true")->opcode == Opcode::jmp_true);
+static_assert(FindOpcode("nop") == nullptr);
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// guest memory map. the vm and the aot runtime both derive their memory from this.
+
+static constexpr std::uint64_t offset_program = 0; // must be zero because no PIE. programs may use everything below the console.
+static constexpr std::uint64_t offset_console = 2000;
+static constexpr std::uint64_t offset_console_printc = offset_console+0;
+static constexpr std::uint64_t offset_console_printcstr = offset_console+100;
+
+static constexpr std::uint64_t IO_PRINTC_DATA = 3000;
+static constexpr std::uint64_t IO_PRINTC_ENABLE = 3001;
+// u8 per core. write 1 to start the core, reset to 0 once picked up.
+// guests write it with fadd_u8 or cas_u8 so the pc written before is visible to the started core.
+static constexpr std::uint64_t IO_CORE_START = 3010;
+static constexpr std::uint64_t IO_CORE_PC = 3020; // u64 per core. pc the core starts at.
+
+static constexpr std::uint64_t core_count = 4;
+static constexpr std::uint64_t offset_stacks = 4000; // core n has its stack at offset_stacks+n*stack_size
+static constexpr std::uint64_t stack_size = 1000;
+
+// free for guest data
+static constexpr std::uint64_t offset_data = offset_stacks+core_count*stack_size;
+static constexpr std::uint64_t data_size = 40000;
+
+static constexpr std::uint64_t memory_size = offset_data+data_size;
+
+static_assert(IO_CORE_START+core_count <= IO_CORE_PC && IO_CORE_PC+core_count*8 <= offset_stacks, "io registers overlap");
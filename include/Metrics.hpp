@@ -0,0 +1,338 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+#include <new>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#endif
+
+// runtime metrics a vm publishes in a named shared memory segment.
+// the vm is the only writer. readers attach read-only and never pause it.
+
+static constexpr std::uint64_t metrics_magic = 0x564d4d4554524932ull; // "VMMETRI2". bump with the layout
+static constexpr std::size_t metrics_max_cores = 16;
+static constexpr char const* metrics_segment_prefix = "vm-metrics-";
+
+// one cache line per core so cores publishing do not contend
+struct alignas(64) CoreMetrics
+{
+    std::atomic<std::uint64_t> running{0};
+    std::atomic<std::uint64_t> instructions{0}; // retired
+    std::atomic<std::uint64_t> pc{0};
+    std::atomic<std::uint64_t> stack_high_water{0};
+};
+
+struct VmMetrics
+{
+    std::atomic<std::uint64_t> magic{0};
+    std::atomic<std::uint64_t> pid{0};
+    // tell the vm apart from another process with the same pid. 0 if unknown.
+    std::atomic<std::uint64_t> pid_namespace{0};
+    std::atomic<std::uint64_t> start_time{0}; // clock ticks after boot
+    std::atomic<std::uint64_t> core_count{0};
+    std::atomic<std::uint64_t> instructions_per_sec{0};
+    std::atomic<std::uint64_t> console_pending{0}; // chars waiting for the console peripheral
+    std::atomic<std::uint64_t> console_bytes_out{0};
+    CoreMetrics cores[metrics_max_cores];
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "metrics must be lock-free to live in shared memory");
+
+inline std::uint64_t CurrentPid()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return (std::uint64_t)getpid();
+#endif
+}
+
+inline bool ProcessAlive(std::uint64_t pid)
+{
+#ifdef _WIN32
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+    if (process == nullptr)
+        return GetLastError() == ERROR_ACCESS_DENIED;
+    DWORD exitCode = 0;
+    bool alive = GetExitCodeProcess(process, &exitCode) && exitCode == STILL_ACTIVE;
+    CloseHandle(process);
+    return alive;
+#else
+    // EPERM means the process exists but belongs to someone else
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+inline std::string MetricsSegmentName(std::uint64_t pid)
+{
+#ifdef _WIN32
+    return "Local\\" + (metrics_segment_prefix + std::to_string(pid));
+#else
+    return "/" + (metrics_segment_prefix + std::to_string(pid));
+#endif
+}
+
+// pids of every metrics segment, including those left behind by vms that were killed.
+// windows drops a mapping with its last handle, so there segments are only found by pid.
+inline std::vector<std::uint64_t> MetricsSegments()
+{
+    std::vector<std::uint64_t> pids;
+#ifndef _WIN32
+    std::string const prefix = metrics_segment_prefix;
+    std::error_code error;
+    for (auto const& entry : std::filesystem::directory_iterator("/dev/shm", error))
+    {
+        std::string name = entry.path().filename().string();
+        std::string pid = name.substr(std::min(prefix.size(), name.size()));
+        if (name.compare(0, prefix.size(), prefix) == 0 && !pid.empty() && pid.size() < 20 && std::all_of(pid.begin(), pid.end(), [](char c) { return std::isdigit((unsigned char)c); }))
+            pids.push_back(std::stoull(pid));
+    }
+#endif
+    return pids;
+}
+
+// inode of the pid namespace of this process. pids only compare within one namespace.
+inline std::uint64_t PidNamespace()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct stat info;
+    return stat("/proc/self/ns/pid", &info) == 0 ? (std::uint64_t)info.st_ino : 0;
+#endif
+}
+
+// start time of pid in clock ticks after boot. 0 if there is no such process or it cannot be read.
+inline std::uint64_t ProcessStartTime(std::uint64_t pid)
+{
+#ifdef _WIN32
+    (void)pid;
+    return 0;
+#else
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string line;
+    if (!std::getline(file, line))
+        return 0;
+    // the command name may hold spaces and parentheses. the fields follow its last ')'
+    std::size_t end = line.rfind(')');
+    if (end == std::string::npos)
+        return 0;
+    std::istringstream fields(line.substr(end + 1));
+    std::string field;
+    // state is field 3, starttime field 22
+    for (int i = 3; i <= 22; ++i)
+    {
+        if (!(fields >> field))
+            return 0;
+    }
+    return std::all_of(field.begin(), field.end(), [](char c) { return std::isdigit((unsigned char)c); }) ? std::stoull(field) : 0;
+#endif
+}
+
+// maps the metrics segment of a vm. the vm creates it, readers open it.
+// if creating fails the vm keeps publishing into private memory instead.
+class SharedMetrics
+{
+    VmMetrics* metrics = nullptr;
+    bool owner = false;
+    bool shared = false;
+    std::string name;
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    static SharedMetrics Create(std::uint64_t pid)
+    {
+        SharedMetrics result;
+        result.owner = true;
+        result.name = MetricsSegmentName(pid);
+        void* memory = nullptr;
+#ifdef _WIN32
+        result.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(VmMetrics), result.name.c_str());
+        if (result.mapping != nullptr)
+            memory = MapViewOfFile(result.mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(VmMetrics));
+#else
+        int fd = shm_open(result.name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+        if (fd != -1)
+        {
+            if (ftruncate(fd, sizeof(VmMetrics)) == 0)
+            {
+                memory = mmap(nullptr, sizeof(VmMetrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (memory == MAP_FAILED)
+                    memory = nullptr;
+            }
+            close(fd);
+            if (memory == nullptr)
+                shm_unlink(result.name.c_str());
+        }
+#endif
+        result.shared = memory != nullptr;
+        if (!result.shared)
+            memory = ::operator new(sizeof(VmMetrics), std::align_val_t(alignof(VmMetrics)));
+
+        result.metrics = new(memory) VmMetrics();
+        result.metrics->pid.store(pid, std::memory_order_relaxed);
+        result.metrics->pid_namespace.store(PidNamespace(), std::memory_order_relaxed);
+        result.metrics->start_time.store(ProcessStartTime(pid), std::memory_order_relaxed);
+        // published last so readers never see a half initialized block
+        result.metrics->magic.store(metrics_magic, std::memory_order_release);
+        return result;
+    }
+
+    // returns an invalid instance if no vm with pid publishes metrics
+    static SharedMetrics Open(std::uint64_t pid)
+    {
+        SharedMetrics result;
+        result.name = MetricsSegmentName(pid);
+        void* memory = nullptr;
+#ifdef _WIN32
+        result.mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, result.name.c_str());
+        if (result.mapping != nullptr)
+            memory = MapViewOfFile(result.mapping, FILE_MAP_READ, 0, 0, sizeof(VmMetrics));
+#else
+        int fd = shm_open(result.name.c_str(), O_RDONLY, 0);
+        if (fd != -1)
+        {
+            struct stat info;
+            if (fstat(fd, &info) == 0 && (std::size_t)info.st_size >= sizeof(VmMetrics))
+            {
+                memory = mmap(nullptr, sizeof(VmMetrics), PROT_READ, MAP_SHARED, fd, 0);
+                if (memory == MAP_FAILED)
+                    memory = nullptr;
+            }
+            close(fd);
+        }
+#endif
+        result.shared = memory != nullptr;
+        result.metrics = (VmMetrics*)memory;
+        if (result.metrics != nullptr && result.metrics->magic.load(std::memory_order_acquire) != metrics_magic)
+            result.Release();
+        return result;
+    }
+
+    SharedMetrics() = default;
+
+    SharedMetrics(SharedMetrics&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    SharedMetrics& operator=(SharedMetrics&& other) noexcept
+    {
+        Release();
+        metrics = other.metrics;
+        owner = other.owner;
+        shared = other.shared;
+        name = std::move(other.name);
+        other.metrics = nullptr;
+#ifdef _WIN32
+        mapping = other.mapping;
+        other.mapping = nullptr;
+#endif
+        return *this;
+    }
+
+    ~SharedMetrics()
+    {
+        Release();
+    }
+
+    bool Valid() const
+    {
+        return metrics != nullptr;
+    }
+
+    bool Shared() const
+    {
+        return shared;
+    }
+
+    std::string const& Name() const
+    {
+        return name;
+    }
+
+    VmMetrics& Get()
+    {
+        return *metrics;
+    }
+
+private:
+    void Release()
+    {
+        if (metrics != nullptr)
+        {
+            if (!shared)
+            {
+                metrics->~VmMetrics();
+                ::operator delete(metrics, std::align_val_t(alignof(VmMetrics)));
+            }
+            else
+            {
+#ifdef _WIN32
+                UnmapViewOfFile(metrics);
+#else
+                munmap(metrics, sizeof(VmMetrics));
+                if (owner)
+                    shm_unlink(name.c_str());
+#endif
+            }
+            metrics = nullptr;
+        }
+#ifdef _WIN32
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        mapping = nullptr;
+#endif
+    }
+};
+
+// true only if the vm that created the segment of pid has provably exited. a block written in
+// another pid namespace, or by a vm whose start time is unknown, counts as alive.
+inline bool MetricsOwnerGone(VmMetrics const& metrics, std::uint64_t pid)
+{
+    std::uint64_t pidNamespace = metrics.pid_namespace.load(std::memory_order_relaxed);
+    std::uint64_t startTime = metrics.start_time.load(std::memory_order_relaxed);
+    if (metrics.pid.load(std::memory_order_relaxed) != pid || pidNamespace == 0 || startTime == 0 || pidNamespace != PidNamespace())
+        return false;
+    std::uint64_t current = ProcessStartTime(pid);
+    // a process that hides its stat is still there
+    if (current == 0)
+        return !ProcessAlive(pid);
+    // a different start time means the pid was reused
+    return current != startTime;
+}
+
+// unlinks the segments of vms that are gone. a vm killed before it could clean up leaves its segment behind.
+// segments of another layout, or that cannot be matched to their vm, are left alone.
+inline void RemoveStaleMetrics()
+{
+#ifndef _WIN32
+    for (std::uint64_t pid : MetricsSegments())
+    {
+        SharedMetrics metrics = SharedMetrics::Open(pid);
+        if (metrics.Valid() && MetricsOwnerGone(metrics.Get(), pid))
+            shm_unlink(metrics.Name().c_str());
+    }
+#endif
+}
@@ -1,57 +1,52 @@
 #include "DataWriter.hpp"
 #include "IncrementalWriter.hpp"
+#include "Isa.hpp"
+#include "Layout.hpp"
+#include "Cores.hpp"
+#include "Metrics.hpp"
 
 #include <iostream>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include <fstream>
 #include <filesystem>
 
-static constexpr u8 opcode_size = 2;
-
-enum class Opcode
-{
-    // args | descr
-    jmp = 0, // addr | jump to addr
-    jmps, // - | jump to addr on stack. consumes addr.
-    jmp_true, // address | if byte on stack is 1, jump to address. consumes byte.
-    cmp_u8, // - | consumes two bytes from stack. pushes true on stack if equal. else false.
-    spi, // offset | increment sp
-    spd, // offset | decrease stackpointer
-    push_u8, // u8 | push byte on stack
-    push_u64,
-    pop_u8,
-    set_u8, // offset | set memory to u8 from stack
-    cpl_u8, // offset | copy relative(local) byte to stack
-    cpg_u8, // addr | copy absolute(global) byte to stack
-    halt, // stops machine
-};
-
-static constexpr u64 IO_PRINTC_DATA = 3000;
-static constexpr u64 IO_PRINTC_ENABLE = 3001;
+static_assert(core_count <= metrics_max_cores);
+static constexpr u64 metrics_interval = 1024; // min instructions between metric updates of a core
 
 class PeripheralConsole
 {
     DataWriter memory;
+    VmMetrics& metrics;
     std::thread runner;
-    bool run = false;
+    std::atomic<bool> run = false;
 public:
-    PeripheralConsole(u8* memory) :
-        memory(memory)
+    PeripheralConsole(u8* memory, VmMetrics& metrics) :
+        memory(memory),
+        metrics(metrics)
     {
         this->memory.Set(IO_PRINTC_ENABLE, (u8)0);
     }
 
     void Start()
     {
+        run = true;
         runner = std::thread([this]() {
-            run = true;
             while(run)
             {
                 if(memory.GetU8(IO_PRINTC_ENABLE) == 1)
                 {
+                    metrics.console_pending.store(1, std::memory_order_relaxed);
                     std::this_thread::sleep_for(std::chrono::milliseconds(100));
                     std::cout << memory.GetU8(IO_PRINTC_DATA);
+                    metrics.console_bytes_out.fetch_add(1, std::memory_order_relaxed);
+                    metrics.console_pending.store(0, std::memory_order_relaxed);
                     memory.Set(IO_PRINTC_ENABLE, (u8)0);
                 }
             }
@@ -65,152 +60,268 @@ public:
     }
 };
 
-void Run(u8* _memory, u64 offset_program, u64 offset_stack, bool showOpcodes)
+#if defined(_MSC_VER)
+#define VM_ALWAYS_INLINE __forceinline
+#else
+#define VM_ALWAYS_INLINE [[gnu::always_inline]] inline
+#endif
+
+// state of one core. handlers take and return it by value. they are inlined into the
+// interpreter loop, so it stays in host registers.
+struct Registers
+{
+    u64 pc;
+    u64 sp;
+    u64 highWater; // largest sp so far. kept by the handlers that grow the stack, so no peak is missed.
+};
+
+// pc a handler returns once the core halted
+static constexpr u64 pc_halted = ~(u64)0;
+
+// one instantiation per opcode. operand decoding and pc advance come from the isa table.
+template<Opcode op>
+VM_ALWAYS_INLINE Registers Execute(u8* _memory, u8* _stack, Registers registers)
+{
+    static constexpr OpcodeInfo info = isa[(u64)op];
+
+    DataWriter memory(_memory);
+    DataWriter stack(_stack);
+    u64& pc = registers.pc;
+    u64& sp = registers.sp;
+    u64& highWater = registers.highWater;
+
+    u64 arg = 0;
+    if constexpr (info.operand == Operand::u8)
+        arg = memory.GetU8(pc+opcode_size);
+    else if constexpr (info.OperandSize() == 8)
+        arg = memory.GetU64(pc+opcode_size);
+
+    if constexpr (op == Opcode::jmp)
+    {
+        pc = arg;
+    }
+    else if constexpr (op == Opcode::jmps)
+    {
+        pc = stack.GetU64(sp-8);
+        sp -= 8;
+    }
+    else if constexpr (op == Opcode::jmp_true)
+    {
+        pc = (bool)stack.GetU8(sp-1) ? arg : pc+info.Size();
+        sp -= 1;
+    }
+    else if constexpr (op == Opcode::cmp_u8)
+    {
+        stack.Set(sp-2, (u8)(stack.GetU8(sp-1) == stack.GetU8(sp-2)));
+        sp -= 1;
+    }
+    else if constexpr (op == Opcode::spi)
+    {
+        sp += arg;
+        highWater = std::max(highWater, sp);
+    }
+    else if constexpr (op == Opcode::spd)
+    {
+        sp -= arg;
+    }
+    else if constexpr (op == Opcode::push_u8)
+    {
+        stack.Set(sp, (u8)arg);
+        sp += 1;
+        highWater = std::max(highWater, sp);
+    }
+    else if constexpr (op == Opcode::push_u64)
+    {
+        stack.Set(sp, arg);
+        sp += 8;
+        highWater = std::max(highWater, sp);
+    }
+    else if constexpr (op == Opcode::pop_u8)
+    {
+        sp -= 1;
+    }
+    else if constexpr (op == Opcode::set_u8)
+    {
+        memory.Set(arg, stack.GetU8(sp-1));
+        sp -= 1;
+    }
+    else if constexpr (op == Opcode::cpl_u8)
+    {
+        stack.Set(sp, stack.GetU8(sp-arg));
+        sp += 1;
+        highWater = std::max(highWater, sp);
+    }
+    else if constexpr (op == Opcode::cpg_u8)
+    {
+        stack.Set(sp, memory.GetU8(arg));
+        sp += 1;
+        highWater = std::max(highWater, sp);
+    }
+    else if constexpr (op == Opcode::halt)
+    {
+        return {pc_halted, sp, highWater};
+    }
+    else if constexpr (op == Opcode::cas_u8)
+    {
+        u8 expected = stack.GetU8(sp-2);
+        std::atomic_ref<u8> target(_memory[arg]);
+        bool swapped = target.compare_exchange_strong(expected, stack.GetU8(sp-1));
+        stack.Set(sp-2, (u8)swapped);
+        sp -= 1;
+    }
+    else if constexpr (op == Opcode::fadd_u8)
+    {
+        std::atomic_ref<u8> target(_memory[arg]);
+        stack.Set(sp-1, target.fetch_add(stack.GetU8(sp-1)));
+    }
+    else
+    {
+        static_assert(op == Opcode::fence, "opcode has no handler");
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    if constexpr (!(info.flags & flag_control))
+        pc += info.Size();
+    return registers;
+}
+
+// one case per opcode of the isa
+VM_ALWAYS_INLINE Registers Dispatch(u16 opcode, u8* _memory, u8* _stack, Registers registers)
+{
+    switch((Opcode)opcode)
+    {
+#define VM_CASE(name, operand, flags) case Opcode::name: return Execute<Opcode::name>(_memory, _stack, registers);
+        ISA_OPCODES(VM_CASE)
+#undef VM_CASE
+    }
+    // unknown opcodes are rejected before dispatch
+    return registers;
+}
+
+void Trace(DataWriter memory, u64 pc, u16 opcode)
 {
-    DataWriter stack(_memory + offset_stack);
+    OpcodeInfo const& info = isa[opcode];
+    std::cout << info.mnemonic;
+    if (info.operand == Operand::u8)
+        std::cout << ": " << (u32)memory.GetU8(pc+opcode_size);
+    else if (info.OperandSize() == 8)
+        std::cout << ": " << memory.GetU64(pc+opcode_size);
+    std::cout << std::endl;
+}
+
+// runs one core until it halts, or until stopping is set because core 0 halted
+void Run(u8* _memory, u64 core, u64 pc, bool showOpcodes, CoreMetrics& metrics, std::atomic<bool> const& stopping)
+{
+    u8* _stack = _memory + offset_stacks + core*stack_size;
     DataWriter memory(_memory);
 
-    u64 pc = offset_program;
-    u64 sp = 0;
+    Registers registers{pc, 0, 0};
+    bool halted = false;
+    u64 retired = 0;
+    u64 nextPublish = 0;
+
+    // the loop only compares retired against nextPublish. the high water mark is kept by the handlers.
+    auto publish = [&]() {
+        nextPublish = retired + metrics_interval;
+        metrics.instructions.store(retired, std::memory_order_relaxed);
+        metrics.pc.store(registers.pc, std::memory_order_relaxed);
+        metrics.stack_high_water.store(registers.highWater, std::memory_order_relaxed);
+    };
+
+    metrics.running.store(1, std::memory_order_relaxed);
     while(true)
     {
-        //std::cout << "sp: " << sp << std::endl;
-        //std::cout << "pc: " << pc << std::endl;
-        Opcode opcode = (Opcode)memory.GetU16(pc);
-        //std::cout << (u16)opcode << std::endl;
-        switch(opcode)
+        u16 opcode = memory.GetU16(registers.pc);
+        if (opcode_length[opcode] == 0)
         {
-            case Opcode::jmp:
-            {
-                if(showOpcodes)
-                    std::cout << "jmp";
-                u64 addr = memory.GetU64(pc+opcode_size);
-                if(showOpcodes)
-                    std::cout << ": " << addr << std::endl;
-                pc = addr;
-            }
-            break;
-            case Opcode::jmps:
-            {
-                if(showOpcodes)
-                    std::cout << "jmps";
-                u64 addr = stack.GetU64(sp-8);
-                if(showOpcodes)
-                    std::cout << ": " << addr << std::endl;
-                sp -= 8;
-                pc = addr;
-            }
-            break;
-            case Opcode::jmp_true:
-            {
-                if(showOpcodes)
-                    std::cout << "jmp_true";
-                if ((bool)stack.GetU8(sp-1))
-                {
-                    pc = memory.GetU64(pc+opcode_size);
-                    if(showOpcodes)
-                        std::cout << ": " << pc << std::endl;
-                }
-                else
-                {
-                    pc += opcode_size+8;
-                    if(showOpcodes)
-                        std::cout << ": false" << std::endl;
-                }
-                sp -= 1;
-            }
-            break;
-            case Opcode::push_u8:
-            {
-                if(showOpcodes)
-                    std::cout << "push_u8" << std::endl;
-                stack.Set(sp, memory.GetU8(pc+opcode_size));
-                sp += 1;
-                pc += opcode_size+1;
-            }
-            break;
-            case Opcode::push_u64:
-            {
-                if(showOpcodes)
-                    std::cout << "push_u64" << std::endl;
-                stack.Set(sp, memory.GetU64(pc+opcode_size));
-                sp += 8;
-                pc += opcode_size+8;
-            }
-            break;
-            case Opcode::cpl_u8:
-            {
-                if(showOpcodes)
-                    std::cout << "cpl_u8" << std::endl;
-                stack.Set(sp, stack.GetU8(sp-memory.GetU64(pc+opcode_size)));
-                sp += 1;
-                pc += opcode_size+8;
-            }
-            break;
-            case Opcode::cpg_u8:
-            {
-                if(showOpcodes)
-                    std::cout << "cpg_u8" << std::endl;
-                stack.Set(sp, memory.GetU8(memory.GetU64(pc+opcode_size)));
-                sp += 1;
-                pc += opcode_size+8;
-            }
-            break;
-            case Opcode::cmp_u8:
-            {
-                if(showOpcodes)
-                    std::cout << "cmp_u8" << std::endl;
-                stack.Set(sp-2, (u8)(stack.GetU8(sp-1) == stack.GetU8(sp-2)));
-                sp += -1;
-                pc += opcode_size;
-            }
-            break;
-            case Opcode::pop_u8:
-            {
-                if(showOpcodes)
-                    std::cout << "pop_u8" << std::endl;
-                sp += -1;
-                pc += opcode_size;
-            }
+            std::cout << "UNKNOWN OPCODE " << (u32)opcode << std::endl;
             break;
-            case Opcode::spd:
-            {
-                if(showOpcodes)
-                    std::cout << "spd" << std::endl;
-                sp -= memory.GetU64(pc+opcode_size);
-                pc += opcode_size+8;
-            }
-            break;
-            case Opcode::spi:
-            {
-                if(showOpcodes)
-                    std::cout << "spi" << std::endl;
-                sp += memory.GetU64(pc+opcode_size);
-                pc += opcode_size+8;
-            }
-            break;
-            case Opcode::set_u8:
-                if(showOpcodes)
-                    std::cout << "set_u8" << std::endl;
-                memory.Set(memory.GetU64(pc+opcode_size), stack.GetU8(sp-1));
-                sp += -1;
-                pc += opcode_size+8;
-            break;
-            case Opcode::halt:
-            {
-                std::cout << "halt" << std::endl;
-                std::cout << "sp: " << sp << std::endl;
-                
-                return;
-            }
+        }
+        if(showOpcodes)
+            Trace(memory, registers.pc, opcode);
+        ++retired;
+        Registers next = Dispatch(opcode, _memory, _stack, registers);
+        if (next.pc == pc_halted)
+        {
+            // keeps the pc of the halt for the metrics
+            registers.sp = next.sp;
+            registers.highWater = next.highWater;
+            halted = true;
             break;
-            default:
+        }
+        registers = next;
+        if (retired >= nextPublish)
+        {
+            if (stopping.load(std::memory_order_relaxed))
+                break;
+            publish();
+        }
+    }
+    publish();
+    metrics.running.store(0, std::memory_order_relaxed);
+
+    // core 0 halting stops the machine. other cores only stop themselves.
+    if (halted && core == 0)
+    {
+        std::cout << "halt" << std::endl;
+        std::cout << "sp: " << registers.sp << std::endl;
+    }
+}
+
+// derives instructions/sec from the retired counts the cores publish
+class MetricsSampler
+{
+    VmMetrics& metrics;
+    std::thread runner;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool run = false;
+
+    u64 Retired()
+    {
+        u64 total = 0;
+        for (u64 core = 0; core < core_count; ++core)
+            total += metrics.cores[core].instructions.load(std::memory_order_relaxed);
+        return total;
+    }
+public:
+    MetricsSampler(VmMetrics& metrics) :
+        metrics(metrics)
+    {
+        metrics.core_count.store(core_count, std::memory_order_relaxed);
+    }
+
+    void Start()
+    {
+        run = true;
+        runner = std::thread([this]() {
+            auto last = std::chrono::steady_clock::now();
+            u64 lastRetired = Retired();
+            std::unique_lock<std::mutex> lock(mutex);
+            // waits instead of sleeping so Stop() does not stall on the interval
+            while(!wake.wait_for(lock, std::chrono::milliseconds(250), [this]() { return !run; }))
             {
-                std::cout << "UNKNOWN OPCODE " << (u32)opcode << std::endl;
+                auto now = std::chrono::steady_clock::now();
+                u64 retired = Retired();
+                u64 elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - last).count();
+                if (elapsed != 0)
+                    metrics.instructions_per_sec.store((retired - lastRetired) * 1000000 / elapsed, std::memory_order_relaxed);
+                last = now;
+                lastRetired = retired;
             }
+        });
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            run = false;
         }
+        wake.notify_one();
+        runner.join();
     }
-}
+};
 
 void LoadBin(u8* memory, std::string const& filename, u64 offset)
 {
@@ -223,18 +334,11 @@ int main(int argc, char *argv[])
 {
     if (argc < 3)
     {
-        std::cout << "Usage: " << std::experimental::filesystem::path(argv[0]).stem() << " binary libdir" << std::endl;
+        std::cout << "Usage: " << std::filesystem::path(argv[0]).stem() << " binary libdir" << std::endl;
         return 1;
     }
 
-    static constexpr u64 offset_program = 0; // must be zero because no PIE
-    static constexpr u64 offset_stack = 1000;
-    static constexpr u64 offset_console = 2000;
-    static constexpr u64 offset_console_printc = offset_console+0;
-    static constexpr u64 offset_console_printcstr = offset_console+100;
-
-    std::vector<u8> memory;
-    memory.reserve(4000);
+    std::vector<u8> memory(memory_size);
 
     LoadBin(memory.data(), argv[1], offset_program);
     
@@ -242,15 +346,33 @@ int main(int argc, char *argv[])
     LoadBin(memory.data(), std::string(argv[2])+"/console/printcstr.bin", offset_console_printcstr);
 
 
-    PeripheralConsole perConsole(memory.data());
+    RemoveStaleMetrics();
+    SharedMetrics sharedMetrics = SharedMetrics::Create(CurrentPid());
+    if (!sharedMetrics.Shared())
+        std::cout << "Could not create metrics segment " << sharedMetrics.Name() << std::endl;
+    VmMetrics& metrics = sharedMetrics.Get();
+
+    MetricsSampler sampler(metrics);
+    sampler.Start();
+
+    PeripheralConsole perConsole(memory.data(), metrics);
     perConsole.Start();
 
     bool showOpcodes = false;
     if (argc == 4)
         showOpcodes = true;
 
-    Run(memory.data(), offset_program, offset_stack, showOpcodes);
+    PeripheralCores perCores(memory.data(), [&](u64 core, u64 pc, std::atomic<bool> const& stopping) {
+        Run(memory.data(), core, pc, showOpcodes, metrics.cores[core], stopping);
+        return true;
+    });
+    perCores.Start();
+
+    // core 0 runs on the main thread. once it halts the other cores are stopped.
+    Run(memory.data(), 0, offset_program, showOpcodes, metrics.cores[0], perCores.Stopping());
+    perCores.Stop();
     perConsole.Stop();
+    sampler.Stop();
 
     return 0;
 }
\ No newline at end of file
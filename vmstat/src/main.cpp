@@ -0,0 +1,177 @@
+#include "Types.hpp"
+#include "Metrics.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+
+// consistent enough copy of the live block. fields are read one by one without pausing the vm.
+struct Snapshot
+{
+    u64 pid;
+    u64 coreCount;
+    u64 instructions = 0;
+    u64 instructionsPerSec;
+    u64 consolePending;
+    u64 consoleBytesOut;
+    struct Core
+    {
+        bool running;
+        u64 instructions;
+        u64 pc;
+        u64 stackHighWater;
+    };
+    std::vector<Core> cores;
+};
+
+Snapshot Read(VmMetrics& metrics)
+{
+    Snapshot snapshot;
+    snapshot.pid = metrics.pid.load(std::memory_order_relaxed);
+    snapshot.coreCount = std::min<u64>(metrics.core_count.load(std::memory_order_relaxed), metrics_max_cores);
+    snapshot.instructionsPerSec = metrics.instructions_per_sec.load(std::memory_order_relaxed);
+    snapshot.consolePending = metrics.console_pending.load(std::memory_order_relaxed);
+    snapshot.consoleBytesOut = metrics.console_bytes_out.load(std::memory_order_relaxed);
+    for (u64 i = 0; i < snapshot.coreCount; ++i)
+    {
+        CoreMetrics& core = metrics.cores[i];
+        Snapshot::Core copy;
+        copy.running = core.running.load(std::memory_order_relaxed) != 0;
+        copy.instructions = core.instructions.load(std::memory_order_relaxed);
+        copy.pc = core.pc.load(std::memory_order_relaxed);
+        copy.stackHighWater = core.stack_high_water.load(std::memory_order_relaxed);
+        snapshot.instructions += copy.instructions;
+        snapshot.cores.push_back(copy);
+    }
+    return snapshot;
+}
+
+std::string Text(Snapshot const& snapshot)
+{
+    std::stringstream out;
+    out << "vm " << snapshot.pid << "\n";
+    out << "  instructions      " << snapshot.instructions << "\n";
+    out << "  instructions/sec  " << snapshot.instructionsPerSec << "\n";
+    out << "  console           pending " << snapshot.consolePending << ", bytes out " << snapshot.consoleBytesOut << "\n";
+    for (u64 i = 0; i < snapshot.cores.size(); ++i)
+    {
+        auto const& core = snapshot.cores[i];
+        out << "  core " << i << (core.running ? "  running" : "  stopped")
+            << "  pc " << std::hex << std::uppercase << core.pc << std::dec
+            << "  instructions " << core.instructions
+            << "  stack high water " << core.stackHighWater << "\n";
+    }
+    return out.str();
+}
+
+// one object per line so --watch output can be streamed
+std::string Json(Snapshot const& snapshot)
+{
+    std::stringstream out;
+    out << "{\"pid\":" << snapshot.pid
+        << ",\"instructions\":" << snapshot.instructions
+        << ",\"instructions_per_sec\":" << snapshot.instructionsPerSec
+        << ",\"console\":{\"pending\":" << snapshot.consolePending << ",\"bytes_out\":" << snapshot.consoleBytesOut << "}"
+        << ",\"cores\":[";
+    for (u64 i = 0; i < snapshot.cores.size(); ++i)
+    {
+        auto const& core = snapshot.cores[i];
+        out << (i == 0 ? "" : ",")
+            << "{\"core\":" << i
+            << ",\"running\":" << (core.running ? "true" : "false")
+            << ",\"pc\":" << core.pc
+            << ",\"instructions\":" << core.instructions
+            << ",\"stack_high_water\":" << core.stackHighWater << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+// vms that are gone still leave their segment if they were killed. those are reported and skipped.
+// status messages go to stderr so stdout stays a clean --json stream.
+bool CheckAlive(u64 pid)
+{
+    if (ProcessAlive(pid))
+        return true;
+    std::cerr << "vm " << pid << " is not running" << std::endl;
+    return false;
+}
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    u64 watchMs = 0;
+    std::vector<u64> pids;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        std::string option = argv[arg];
+        if (option == "--json")
+            json = true;
+        else if (option == "--watch" && arg+1 < argc)
+            watchMs = std::stoull(argv[++arg]);
+        else if (!option.empty() && std::isdigit((unsigned char)option[0]))
+            pids.push_back(std::stoull(option));
+        else
+        {
+            std::cout << "Usage: " << std::filesystem::path(argv[0]).stem() << " [--json] [--watch ms] [pid...]" << std::endl;
+            std::cout << "Without pids it attaches to every running vm." << std::endl;
+            return 1;
+        }
+    }
+
+    if (pids.empty())
+        pids = MetricsSegments();
+    pids.erase(std::remove_if(pids.begin(), pids.end(), [](u64 pid) { return !CheckAlive(pid); }), pids.end());
+    if (pids.empty())
+    {
+        std::cerr << "No running vm found" << std::endl;
+        return 1;
+    }
+
+    std::vector<SharedMetrics> attached;
+    for (u64 pid : pids)
+    {
+        SharedMetrics metrics = SharedMetrics::Open(pid);
+        if (!metrics.Valid())
+        {
+            std::cerr << "No metrics for vm " << pid << std::endl;
+            continue;
+        }
+        attached.push_back(std::move(metrics));
+    }
+    if (attached.empty())
+        return 1;
+
+    while(true)
+    {
+        for (auto& metrics : attached)
+        {
+            Snapshot snapshot = Read(metrics.Get());
+            std::cout << (json ? Json(snapshot) : Text(snapshot));
+        }
+        std::cout << std::flush;
+
+        if (watchMs == 0)
+            break;
+        // a vm that exits while watched keeps its last values mapped. stop showing it.
+        attached.erase(std::remove_if(attached.begin(), attached.end(), [](SharedMetrics& metrics) {
+            u64 pid = metrics.Get().pid.load(std::memory_order_relaxed);
+            if (ProcessAlive(pid))
+                return false;
+            std::cerr << "vm " << pid << " exited" << std::endl;
+            return true;
+        }), attached.end());
+        if (attached.empty())
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(watchMs));
+    }
+
+    return 0;
+}
\ No newline at end of file